@@ -0,0 +1,294 @@
+/***************************************************************/
+/*                                                             */
+/*  BATCH.C                                                    */
+/*                                                             */
+/*  Run Remind for a whole manifest of users and reminder      */
+/*  files in one go.                                           */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "types.h"
+#include "protos.h"
+#include "expr.h"
+#include "globals.h"
+#include "err.h"
+
+/* Most words allowed on one line of a manifest */
+#define MAX_BATCH_WORDS 64
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW 0
+#endif
+
+static int SplitWords(char *s, char **words, int max);
+static void RunBatchEntry(char **words, int n);
+static int ReapBatchEntry(int *running);
+static void OpenBatchOutput(char const *name);
+
+/***************************************************************/
+/*                                                             */
+/*  RunBatch                                                   */
+/*                                                             */
+/*  Handle --batch: read the manifest, one line at a time.     */
+/*  Each line is either                                        */
+/*                                                             */
+/*    PRELOAD path...                                          */
+/*    user output [option...] file [date...]                   */
+/*                                                             */
+/*  PRELOAD reads files (or directories of *.rem files) into   */
+/*  the file cache, where every later entry finds them.  An    */
+/*  entry runs Remind as "remind -u<user> [option...] file     */
+/*  [date...]" with its output going to the file output.  A    */
+/*  user of "-" means no -u option, and an output of "-"       */
+/*  means standard output.  Each entry is run in a child       */
+/*  process, so entries can't affect each other; --jobs=N      */
+/*  runs up to N of them at once.  Blank lines and lines       */
+/*  starting with "#" are ignored.                             */
+/*                                                             */
+/*  Returns 0 if every entry succeeded, 1 otherwise.           */
+/*                                                             */
+/***************************************************************/
+int RunBatch(void)
+{
+    FILE *mf;
+    DynamicBuffer line, text;
+    char *s, *next;
+    char *words[MAX_BATCH_WORDS];
+    int n, i, r;
+    int lineno = 0;
+    int running = 0;
+    int failed = 0;
+    pid_t pid;
+
+    if (!strcmp(BatchManifest, "-")) {
+	mf = stdin;
+    } else {
+	mf = fopen(BatchManifest, "r");
+    }
+    if (!mf) {
+	fprintf(ErrFp, "%s: `%s'.\n", ErrMsg[E_CANT_OPEN], BatchManifest);
+	return 1;
+    }
+
+    /* Read the whole manifest before starting any entries: a child
+       exiting while the manifest is still open could move the file
+       offset out from under us */
+    DBufInit(&line);
+    DBufInit(&text);
+    while (DBufGets(&line, mf) == OK) {
+	if (!DBufLen(&line) && feof(mf)) break;
+	if (DBufPuts(&text, DBufValue(&line)) != OK ||
+	    DBufPutc(&text, '\n') != OK) {
+	    fprintf(ErrFp, "%s\n", ErrMsg[E_NO_MEM]);
+	    failed = 1;
+	    break;
+	}
+    }
+    DBufFree(&line);
+    if (mf != stdin) fclose(mf);
+    if (failed) {
+	DBufFree(&text);
+	return 1;
+    }
+
+    ShouldCache = 1;
+    for (s = DBufValue(&text); *s; s = next) {
+	next = strchr(s, '\n');
+	*next++ = 0;
+	lineno++;
+	n = SplitWords(s, words, MAX_BATCH_WORDS);
+	if (n < 0) {
+	    fprintf(ErrFp, "%s(%d): %s\n", BatchManifest, lineno,
+		    ErrMsg[E_LINE_2_LONG]);
+	    failed = 1;
+	} else if (n == 0 || *words[0] == '#') {
+	    /* Nothing to do */
+	} else if (!strcmp(words[0], "PRELOAD")) {
+	    for (i=1; i<n; i++) {
+		r = PreloadFile(words[i]);
+		if (r) {
+		    fprintf(ErrFp, "%s(%d): %s: %s\n", BatchManifest, lineno,
+			    ErrMsg[r], words[i]);
+		}
+	    }
+	} else if (n < 3) {
+	    fprintf(ErrFp, "%s(%d): %s\n", BatchManifest, lineno,
+		    ErrMsg[E_EOLN]);
+	    failed = 1;
+	} else {
+	    while (running >= CalJobs) {
+		if (ReapBatchEntry(&running)) failed = 1;
+	    }
+	    fflush(stdout);
+	    fflush(stderr);
+	    pid = fork();
+	    if (pid == 0) {
+		RunBatchEntry(words, n);
+	    }
+	    if (pid < 0) {
+		fprintf(ErrFp, "%s\n", ErrMsg[E_CANTFORK]);
+		failed = 1;
+	    } else {
+		running++;
+	    }
+	}
+    }
+    DBufFree(&text);
+
+    while (running) {
+	if (ReapBatchEntry(&running)) failed = 1;
+    }
+    return failed;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ReapBatchEntry                                             */
+/*                                                             */
+/*  Wait for one child running a manifest entry to finish.     */
+/*  Returns 1 if it failed, 0 otherwise.                       */
+/*                                                             */
+/***************************************************************/
+static int ReapBatchEntry(int *running)
+{
+    int status;
+
+    if (wait(&status) < 0) {
+	*running = 0;
+	return 1;
+    }
+    (*running)--;
+    return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunBatchEntry                                              */
+/*                                                             */
+/*  In the child: run Remind for one manifest entry, starting  */
+/*  from the settings given with --batch and the files it      */
+/*  preloaded.  Never returns.                                 */
+/*                                                             */
+/***************************************************************/
+static void RunBatchEntry(char **words, int n)
+{
+    char const **argv;
+    DynamicBuffer user;
+    int argc = 0;
+    int i;
+
+    argv = malloc((n + 1) * sizeof(char const *));
+    if (!argv) {
+	fprintf(ErrFp, "%s\n", ErrMsg[E_NO_MEM]);
+	exit(1);
+    }
+    argv[argc++] = ArgV[0];
+    if (strcmp(words[0], "-")) {
+	DBufInit(&user);
+	DBufPuts(&user, "-u");
+	DBufPuts(&user, words[0]);
+	argv[argc++] = DBufValue(&user);
+    }
+    for (i=2; i<n; i++) {
+	argv[argc++] = words[i];
+    }
+    argv[argc] = NULL;
+
+    ArgC = argc;
+    ArgV = argv;
+    BatchManifest = NULL;
+    InitRemind(argc, argv);
+    if (BatchManifest || ServerSocket) {
+	fprintf(ErrFp, "--batch and --server can't be used in a manifest\n");
+	exit(1);
+    }
+
+    /* We may be someone else now, so only now is it safe to check
+       the cached files and to create the output file */
+    RecheckCachedFiles();
+    OpenBatchOutput(words[1]);
+
+    DontQueue = 1;
+    Daemon = 0;
+    exit(RunRemind());
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OpenBatchOutput                                            */
+/*                                                             */
+/*  In the child: send standard output to the file name,       */
+/*  unless it is "-".  This is done as the entry's user, and   */
+/*  a symbolic link is never followed, so a manifest entry     */
+/*  can't be used to clobber a file the user couldn't write.   */
+/*                                                             */
+/***************************************************************/
+static void OpenBatchOutput(char const *name)
+{
+    int fd;
+
+    if (!strcmp(name, "-")) return;
+    fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0666);
+    if (fd < 0) {
+	fprintf(ErrFp, "%s: %s\n", name, strerror(errno));
+	exit(1);
+    }
+    if (fd != STDOUT_FILENO) {
+	if (dup2(fd, STDOUT_FILENO) < 0) {
+	    fprintf(ErrFp, "%s: %s\n", name, strerror(errno));
+	    exit(1);
+	}
+	close(fd);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SplitWords                                                 */
+/*                                                             */
+/*  Split s in place into blank-separated words.  Double       */
+/*  quotes may be used to put blanks in a word.  Returns the   */
+/*  number of words, or -1 if there are more than max.         */
+/*                                                             */
+/***************************************************************/
+static int SplitWords(char *s, char **words, int max)
+{
+    int n = 0;
+    char *out;
+    char c;
+
+    while (1) {
+	while (isspace(*s)) s++;
+	if (!*s) break;
+	if (n >= max) return -1;
+	words[n++] = out = s;
+	while (*s && !isspace(*s)) {
+	    if (*s == '"') {
+		s++;
+		while (*s && *s != '"') *out++ = *s++;
+		if (*s) s++;
+	    } else {
+		*out++ = *s++;
+	    }
+	}
+	c = *s;
+	*out = 0;
+	if (c) s++;
+    }
+    return n;
+}
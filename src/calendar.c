@@ -19,8 +19,11 @@
 #include <ctype.h>
 
 #include <stdlib.h>
+#include <limits.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #ifdef REM_USE_WCHAR
 #include <wctype.h>
@@ -227,9 +230,83 @@ static struct xterm256_colors XTerm256Colors[] =
     {208, 208, 208}, {218, 218, 218}, {228, 228, 228}, {238, 238, 238}
 };
 
+/* Trigger-related globals as they stand at the end of one calendar
+   day's run through the script */
+typedef struct {
+    Trigger trig;
+    TimeTrig tim;
+    int date;
+    int time;
+    int valid;
+} TrigState;
+
+/* A child process writing part of the calendar for --jobs */
+typedef struct {
+    pid_t pid;
+    int first;
+    int count;
+    FILE *out;
+    FILE *err;
+} CalJob;
+
+/* Where the body of a REM starts, so it can be re-read for each day */
+typedef struct {
+    ParsePtr p;
+    char const *pos;
+    DynamicBuffer pushed;
+    unsigned char expr_happened;
+    unsigned char nonconst_expr;
+} RemBody;
+
+/* When the calendar is generated a day at a time, a REM line in a
+   cached file whose trigger parses the same way every day has the
+   days on which it fires in the window worked out once.  On the
+   other days, its trigger need not be computed at all. */
+struct cal_memo {
+    int dependent;          /* Trigger differs from day to day */
+    int start, ndays;       /* The window "fires" covers */
+    int omits;              /* OmitContextId() it was worked out for */
+    int builds;             /* How often it was worked out in the window */
+    int failed;             /* Couldn't work it out */
+    Trigger trig;           /* The trigger as parsed, without tags */
+    TimeTrig tim;
+    unsigned char *fires;   /* One bit per day of the window */
+    SatMemo sat;            /* For SATISFY lines, rejected candidates */
+};
+
+/* Most times a memo is worked out again for one calendar window
+   because the OMIT context changed */
+#define MAX_MEMO_BUILDS 4
+
+/* Pseudo-column for generating every day of the window in one pass */
+#define CAL_WINDOW -2
+
 /* Global variables */
 static CalEntry *CalColumn[7];
 
+/* When the whole calendar is generated in a single pass, the entries
+   and trigger state for each day of the window live here. */
+static CalEntry **DayEntries = NULL;
+static TrigState *DayTrigState = NULL;
+static int WindowStart;
+static int WindowDays;
+
+/* Cleared if the script does something that differs from day to day */
+static int SinglePassOK;
+
+/* Set if some trigger looks at the trigger state left by earlier lines */
+static int TrigStateNeeded;
+
+/* The window covered by the memos of REM lines, if any */
+static int MemoStart;
+static int MemoDays;
+
+/* Set if a memo let a trigger go uncomputed today, and if the day
+   has to be done again because something then looked at the trigger
+   state after all */
+static int TrigsSkipped;
+static int RedoDay;
+
 static int ColSpaces;
 
 static int DidAMonth;
@@ -250,7 +327,30 @@ static void GenerateCalEntries (int col);
 static void WriteCalHeader (void);
 static void WriteCalTrailer (void);
 static int DoCalRem (ParsePtr p, int col);
-static void WriteSimpleEntries (int col, int jul);
+static int DoCalRemWindow (ParsePtr p);
+static int FinishCalRem (ParsePtr p, Trigger *trig, TimeTrig *tim, int jul, CalEntry **col);
+static int MarkRemBody (RemBody *b, ParsePtr p);
+static void RewindRemBody (RemBody *b);
+static int CalRemOneDay (int jul, Trigger *trig, TimeTrig *tim, void *data);
+static void CheckTrigStateUse (void);
+static void NoteTrigStateUse (void);
+static void PrimeCalendar (void);
+static void DoCalendarRange (int first, int count);
+static void CopyJobOutput (FILE *from, FILE *to);
+static void DoCalendarJobs (int total);
+static void GenerateCalWindow (int start, int ndays);
+static void FillCalColumn (int col);
+static void FreeDayEntries (void);
+static void FreeEntryList (CalEntry *e);
+static int SkipCalRem (ParsePtr p, Trigger const *trig, TimeTrig const *tim);
+static void BuildCalMemo (CalMemo *m, Trigger const *trig, TimeTrig const *tim, int omits);
+static int SetMemoBit (int jul, Trigger *trig, TimeTrig *tim, void *data);
+static int SameTrigger (Trigger const *a, Trigger const *b);
+static int SameTimeTrig (TimeTrig const *a, TimeTrig const *b);
+static SatMemo *CalSatMemo (ParsePtr p, Trigger const *trig, TimeTrig const *tim);
+static void SaveTrigState (TrigState *s);
+static void RestoreTrigState (TrigState const *s);
+static void WriteSimpleEntries (int col, int jul, int y, int m, int d);
 static void WriteTopCalLine (void);
 static void WriteBottomCalLine (void);
 static void WriteIntermediateCalLine (void);
@@ -636,35 +736,331 @@ void ProduceCalendar(void)
     if (CalMonths) {
         FromJulian(JulianToday, &y, &m, &d);
         JulianToday = Julian(y, m, 1);
-        GenerateCalEntries(-1);
-	DidAMonth = 0;
+        PrimeCalendar();
 	if (PsCal == PSCAL_LEVEL3) {
 	    printf("[\n");
 	}
-	while (CalMonths--) {
-	    DoCalendarOneMonth();
-	    DidAMonth = 1;
-	}
+	DoCalendarJobs(CalMonths);
 	if (PsCal == PSCAL_LEVEL3) {
 	    printf("\n]\n");
 	}
-	return;
     } else {
 	if (MondayFirst) JulianToday -= (JulianToday%7);
 	else             JulianToday -= ((JulianToday+1)%7);
 
-        GenerateCalEntries(-1);
+        PrimeCalendar();
 
 	if (!DoSimpleCalendar) {
   	    WriteWeekHeaderLine();
 	    WriteCalDays();
 	    WriteIntermediateCalLine();
 	}
+	DoCalendarJobs(CalWeeks);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalendarRange                                            */
+/*                                                             */
+/*  Write count months (or weeks) of the calendar, starting    */
+/*  first months (or weeks) after JulianToday.                 */
+/*                                                             */
+/***************************************************************/
+static void DoCalendarRange(int first, int count)
+{
+    int y, m, d;
+
+    ResetOmitContextIds();
+    if (CalMonths) {
+	FromJulian(JulianToday, &y, &m, &d);
+	m += first;
+	y += m / 12;
+	m %= 12;
+	JulianToday = Julian(y, m, 1);
+	m += count - 1;
+	y += m / 12;
+	m %= 12;
+	MemoStart = JulianToday;
+	MemoDays = Julian(y, m, DaysInMonth(m, y)) - JulianToday + 1;
+	if (SinglePassOK) {
+	    GenerateCalWindow(MemoStart, MemoDays);
+	}
+	DidAMonth = (first > 0);
+	while (count--) {
+	    DoCalendarOneMonth();
+	    DidAMonth = 1;
+	}
+    } else {
+	JulianToday += 7 * first;
+	MemoStart = JulianToday;
+	MemoDays = 7 * count;
+	if (SinglePassOK) {
+	    GenerateCalWindow(MemoStart, MemoDays);
+	}
+	while (count--) {
+	    DoCalendarOneWeek(CalWeeks - ++first);
+	}
+    }
+    MemoDays = 0;
+    FreeDayEntries();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CopyJobOutput                                              */
+/*                                                             */
+/*  Copy what a calendar job wrote to a temporary file to      */
+/*  "to", and close the temporary file.                        */
+/*                                                             */
+/***************************************************************/
+static void CopyJobOutput(FILE *from, FILE *to)
+{
+    char buf[4096];
+    size_t n;
+
+    rewind(from);
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+	fwrite(buf, 1, n, to);
+    }
+    fclose(from);
+    fflush(to);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalendarJobs                                             */
+/*                                                             */
+/*  Write the total months (or weeks) of the calendar.  With   */
+/*  --jobs=N, split them into up to N runs of consecutive      */
+/*  months or weeks and hand each run to a child process.      */
+/*  The children write to temporary files, which are copied    */
+/*  out in date order, so the result is the same as doing it   */
+/*  all here.  If we run out of processes, we do the rest of   */
+/*  the calendar ourselves, and if a child fails, we do its    */
+/*  run over again.                                            */
+/*                                                             */
+/***************************************************************/
+static void DoCalendarJobs(int total)
+{
+    int njobs = CalJobs;
+    int started, i, first, count, status;
+    int today = JulianToday;
+    CalJob *jobs;
+
+    if (njobs > total) njobs = total;
+    if (njobs <= 1 ||
+	!(jobs = calloc(njobs, sizeof(CalJob)))) {
+	DoCalendarRange(0, total);
+	return;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    first = 0;
+    for (started=0; started<njobs; started++) {
+	count = total / njobs + (started < total % njobs);
+	jobs[started].first = first;
+	jobs[started].count = count;
+	jobs[started].out = tmpfile();
+	jobs[started].err = tmpfile();
+	if (!jobs[started].out || !jobs[started].err) break;
+	jobs[started].pid = fork();
+	if (jobs[started].pid == -1) break;
+	if (jobs[started].pid == 0) {
+	    dup2(fileno(jobs[started].out), STDOUT_FILENO);
+	    dup2(fileno(jobs[started].err), STDERR_FILENO);
+	    DoCalendarRange(first, count);
+	    fflush(stdout);
+	    fflush(stderr);
+	    _exit(ferror(stdout) ? 1 : 0);
+	}
+	first += count;
+    }
+
+    for (i=0; i<started; i++) {
+	if (waitpid(jobs[i].pid, &status, 0) == jobs[i].pid &&
+	    WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+	    CopyJobOutput(jobs[i].err, stderr);
+	    CopyJobOutput(jobs[i].out, stdout);
+	} else {
+	    fclose(jobs[i].err);
+	    fclose(jobs[i].out);
+	    JulianToday = today;
+	    DoCalendarRange(jobs[i].first, jobs[i].count);
+	    fflush(stdout);
+	    fflush(stderr);
+	}
+    }
+    if (started < njobs) {
+	if (jobs[started].out) fclose(jobs[started].out);
+	if (jobs[started].err) fclose(jobs[started].err);
+	JulianToday = today;
+	DoCalendarRange(jobs[started].first, total - jobs[started].first);
+    }
+    free(jobs);
+}
 
-	while (CalWeeks--)
-	    DoCalendarOneWeek(CalWeeks);
+/***************************************************************/
+/*                                                             */
+/*  PrimeCalendar                                              */
+/*                                                             */
+/*  Run the file once without generating entries, and decide   */
+/*  whether the calendar can be generated in a single pass.    */
+/*                                                             */
+/***************************************************************/
+static void PrimeCalendar(void)
+{
+    int errs = NumErrorsSeen;
+
+    SinglePassOK = 1;
+    TrigStateNeeded = 0;
+    GenerateCalEntries(-1);
+
+    /* Error messages and debugging output have to come out
+       interleaved with the calendar, one day at a time */
+    if (NumErrorsSeen != errs ||
+	DebugFlag ||
+	DoSimpleCalDelta) {
+	SinglePassOK = 0;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GenerateCalWindow                                          */
+/*                                                             */
+/*  Generate the entries for ndays days starting at start in   */
+/*  a single pass through the file.  If anything complains,    */
+/*  or the script turns out to differ from day to day after    */
+/*  all, throw the entries away; the calendar will then be     */
+/*  generated a day at a time so the messages appear where     */
+/*  they always have.                                          */
+/*                                                             */
+/***************************************************************/
+static void GenerateCalWindow(int start, int ndays)
+{
+    int errs = NumErrorsSeen;
+
+    DayEntries = calloc(ndays, sizeof(CalEntry *));
+    DayTrigState = malloc(ndays * sizeof(TrigState));
+    if (!DayEntries || !DayTrigState) {
+	free(DayEntries);
+	free(DayTrigState);
+	DayEntries = NULL;
+	DayTrigState = NULL;
 	return;
     }
+    WindowStart = start;
+    WindowDays = ndays;
+
+    SuppressErrors = 1;
+    GenerateCalEntries(CAL_WINDOW);
+    SuppressErrors = 0;
+
+    JulianToday = start;
+    free(DayTrigState);
+    DayTrigState = NULL;
+    if (NumErrorsSeen != errs || !SinglePassOK) {
+	FreeDayEntries();
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FillCalColumn                                              */
+/*                                                             */
+/*  Fill in the entries for today in column col.               */
+/*                                                             */
+/***************************************************************/
+static void FillCalColumn(int col)
+{
+    if (DayEntries) {
+	CalColumn[col] = DayEntries[JulianToday - WindowStart];
+	DayEntries[JulianToday - WindowStart] = NULL;
+    } else {
+	TrigsSkipped = 0;
+	RedoDay = 0;
+	GenerateCalEntries(col);
+	if (RedoDay) {
+	    /* Something looked at a trigger state that a memo had left
+	       stale.  The memos are off now, so do the day again. */
+	    FreeEntryList(CalColumn[col]);
+	    CalColumn[col] = NULL;
+	    GenerateCalEntries(col);
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeDayEntries                                             */
+/*                                                             */
+/*  Free any entries left over from a single-pass run.         */
+/*                                                             */
+/***************************************************************/
+static void FreeDayEntries(void)
+{
+    int i;
+
+    if (!DayEntries) return;
+    for (i=0; i<WindowDays; i++) {
+	FreeEntryList(DayEntries[i]);
+    }
+    free(DayEntries);
+    DayEntries = NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeEntryList                                              */
+/*                                                             */
+/*  Free a list of calendar entries.                           */
+/*                                                             */
+/***************************************************************/
+static void FreeEntryList(CalEntry *e)
+{
+    CalEntry *n;
+
+    while(e) {
+	free(e->text);
+	free(e->raw_text);
+	free(e->filename);
+#ifdef REM_USE_WCHAR
+	if (e->wc_text) free(e->wc_text);
+#endif
+	DBufFree(&(e->tags));
+	n = e->next;
+	free(e);
+	e = n;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SaveTrigState and RestoreTrigState                         */
+/*                                                             */
+/*  Copy the trigger-related globals to and from a TrigState.  */
+/*                                                             */
+/***************************************************************/
+static void SaveTrigState(TrigState *s)
+{
+    memcpy(&s->trig, &LastTrigger, sizeof(Trigger));
+    DBufInit(&(s->trig.tags));
+    s->tim = LastTimeTrig;
+    s->date = LastTriggerDate;
+    s->time = LastTriggerTime;
+    s->valid = LastTrigValid;
+}
+
+static void RestoreTrigState(TrigState const *s)
+{
+    memcpy(&LastTrigger, &s->trig, sizeof(Trigger));
+    DBufInit(&(LastTrigger.tags));
+    LastTimeTrig = s->tim;
+    LastTriggerDate = s->date;
+    LastTriggerTime = s->time;
+    LastTrigValid = s->valid;
 }
 
 /***************************************************************/
@@ -676,14 +1072,15 @@ void ProduceCalendar(void)
 /***************************************************************/
 static void DoCalendarOneWeek(int nleft)
 {
-    int y, m, d, done, i, l, wd;
+    int y[7], m[7], d[7], days[7];
+    int done, i, l, wd;
     char buf[128];
     int LinesWritten = 0;
     int OrigJul = JulianToday;
 
 /* Fill in the column entries */
     for (i=0; i<7; i++) {
-	GenerateCalEntries(i);
+	FillCalColumn(i);
 	JulianToday++;
     }
 
@@ -694,19 +1091,26 @@ static void DoCalendarOneWeek(int nleft)
 	if (MondayFirst) wd = JulianToday % 7;
 	else             wd = (JulianToday + 1) % 7;
 	for (i=0; i<7; i++) {
-	    WriteSimpleEntries(i, OrigJul+i-wd);
+	    days[i] = OrigJul+i-wd;
+	}
+	FromJulianArray(days, 7, y, m, d);
+	for (i=0; i<7; i++) {
+	    WriteSimpleEntries(i, days[i], y[i], m[i], d[i]);
 	}
 	return;
     }
 
 /* Here come the first few lines... */
+    for (i=0; i<7; i++) {
+	days[i] = OrigJul+i;
+    }
+    FromJulianArray(days, 7, y, m, d);
     gon();
     DRAW(tb);
     goff();
     for (i=0; i<7; i++) {
-	FromJulian(OrigJul+i, &y, &m, &d);
-        char const *mon = get_month_name(m);
-        snprintf(buf, sizeof(buf), "%d %s ", d, get_month_abbrev(mon));
+        char const *mon = get_month_name(m[i]);
+        snprintf(buf, sizeof(buf), "%d %s ", d[i], get_month_abbrev(mon));
 	if (OrigJul+i == RealToday)
 	    PrintLeft(buf, ColSpaces, '*');
 	else
@@ -872,7 +1276,7 @@ static int WriteCalendarRow(void)
 /* Fill in the column entries */
     for (i=wd; i<7; i++) {
 	if (d+i-wd > DaysInMonth(m, y)) break;
-	GenerateCalEntries(i);
+	FillCalColumn(i);
 	JulianToday++;
     }
 
@@ -881,7 +1285,7 @@ static int WriteCalendarRow(void)
 /* If it's "Simple Calendar" format, do it simply... */
     if (DoSimpleCalendar) {
 	for (i=wd; i<7 && d+i-wd<=DaysInMonth(m, y); i++) {
-	    WriteSimpleEntries(i, OrigJul+i-wd);
+	    WriteSimpleEntries(i, OrigJul+i-wd, y, m, d+i-wd);
 	}
 	return (d+7-wd <= DaysInMonth(m, y));
     }
@@ -1350,13 +1754,20 @@ static int WriteOneColLine(int col)
 /***************************************************************/
 static void GenerateCalEntries(int col)
 {
-    int r;
+    int r, i;
+    int is_rem;
     Token tok;
     char const *s;
     Parser p;
 
 /* Do some initialization first... */
     PerIterationInit();
+    if (col == CAL_WINDOW) {
+	JulianToday = WindowStart;
+	for (i=0; i<WindowDays; i++) {
+	    SaveTrigState(&DayTrigState[i]);
+	}
+    }
 
     r=IncludeFile(InitialFile);
     if (r) {
@@ -1386,6 +1797,8 @@ static void GenerateCalEntries(int col)
 	else {
 	    /* Create a parser to parse the line */
 	    CreateParser(s, &p);
+	    is_rem = 0;
+	    DateDependent = 0;
 
 	    switch(tok.type) {
 
@@ -1394,7 +1807,7 @@ static void GenerateCalEntries(int col)
 		break;
 
 	    case T_ErrMsg:  r=DoErrMsg(&p);  break;
-	    case T_Rem:     r=DoCalRem(&p, col); break;
+	    case T_Rem:     r=DoCalRem(&p, col); is_rem = 1; break;
 	    case T_If:      r=DoIf(&p);      break;
 	    case T_IfTrig:  r=DoIfTrig(&p);  break;
 	    case T_Else:    r=DoElse(&p);    break;
@@ -1418,6 +1831,7 @@ static void GenerateCalEntries(int col)
 		    DestroyParser(&p);
 		    CreateParser(s, &p);
 		    r=DoCalRem(&p, col);
+		    is_rem = 1;
 		}
 		break;
 	    case T_Pop:     r=PopOmitContext(&p);     break;
@@ -1429,6 +1843,7 @@ static void GenerateCalEntries(int col)
 	    } else {
 		CreateParser(CurLine, &p);
 		r=DoCalRem(&p, col);
+		is_rem = 1;
 		break;
 	    }
 
@@ -1438,10 +1853,36 @@ static void GenerateCalEntries(int col)
 
 	    default:        CreateParser(CurLine, &p);
 		r=DoCalRem(&p, col);
+		is_rem = 1;
 		break;
 	    }
 	    if (r && (!Hush || r != E_RUN_DISABLED)) Eprint("%s", ErrMsg[r]);
 
+	    /* A single pass can only handle per-day differences in
+	       REM lines; everything else must behave the same way
+	       on every day of the calendar */
+	    if (col == -1) {
+		if (tok.type == T_IfTrig ||
+		    tok.type == T_ErrMsg ||
+		    tok.type == T_IncludeCmd ||
+		    (DateDependent && !is_rem)) {
+		    SinglePassOK = 0;
+		}
+	    }
+
+	    /* The count of reminders issued isn't kept for each day,
+	       so a line that reads it needs the calendar done a day
+	       at a time */
+	    if (col < 0 && (DateDependent & DEP_NUMTRIG)) {
+		SinglePassOK = 0;
+	    }
+
+	    /* The body of a REM only sees its own trigger, but other
+	       lines see whatever trigger was computed last */
+	    if ((DateDependent & DEP_TRIG) && !is_rem) {
+		NoteTrigStateUse();
+	    }
+
 	    /* Destroy the parser - free up resources it may be tying up */
 	    DestroyParser(&p);
 	}
@@ -1497,13 +1938,519 @@ static void WriteCalTrailer(void)
 /***************************************************************/
 static int DoCalRem(ParsePtr p, int col)
 {
-    size_t oldLen;
     Trigger trig;
     TimeTrig tim;
+    int r;
+
+    if (col == CAL_WINDOW) {
+	return DoCalRemWindow(p);
+    }
+
+    /* Parse the trigger date and time */
+    if ( (r=ParseRem(p, &trig, &tim, 1)) ) {
+	FreeTrig(&trig);
+	return r;
+    }
+
+    /* A trigger that looks at the trigger state left by earlier
+       lines needs that state to be exact for every day */
+    if (DateDependent & DEP_TRIG) {
+	NoteTrigStateUse();
+    }
+
+    if (col >= 0 && SkipCalRem(p, &trig, &tim)) {
+	TrigsSkipped = 1;
+	FreeTrig(&trig);
+	return OK;
+    }
+    return FinishCalRem(p, &trig, &tim, NO_DATE,
+			(col >= 0) ? &CalColumn[col] : NULL);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SkipCalRem                                                 */
+/*                                                             */
+/*  Return 1 if the memo for the REM line being processed      */
+/*  shows that the trigger just parsed can't fire today, so    */
+/*  there's no need to compute it.  The first time a line is   */
+/*  seen, it is classified: if its trigger depends on nothing  */
+/*  that can change from day to day, the days on which it      */
+/*  fires in the window are worked out; otherwise, it is       */
+/*  always computed.  The memo is worked out again if the      */
+/*  OMIT context changes.                                      */
+/*                                                             */
+/***************************************************************/
+static int SkipCalRem(ParsePtr p, Trigger const *trig, TimeTrig const *tim)
+{
+    CalMemo **slot;
+    CalMemo *m;
+    int omits, day;
+
+    /* Debugging output and the -s deltas must come out exactly
+       as they would if every trigger were computed */
+    if (!MemoDays || TrigStateNeeded || DebugFlag || DoSimpleCalDelta) {
+	return 0;
+    }
+    day = JulianToday - MemoStart;
+    if (day < 0 || day >= MemoDays) return 0;
+
+    slot = CachedLineMemo();
+    if (!slot) return 0;
+    m = *slot;
+    if (!m) {
+	m = NEW(CalMemo);
+	if (!m) return 0;
+	memset(m, 0, sizeof(CalMemo));
+	*slot = m;
+    }
+    if (m->dependent) return 0;
+
+    /* Lines whose triggers have side effects or depend on more than
+       the trigger and the global OMITs always have to be computed,
+       as do lines with no body, which are reported every day */
+    if (p->isnested ||
+	trig->typ == NO_TYPE ||
+	trig->typ == SAT_TYPE ||
+	trig->addomit ||
+	trig->omitfunc[0] ||
+	(DateDependent & DEP_TRIG)) {
+	m->dependent = 1;
+	return 0;
+    }
+
+    omits = OmitContextId();
+    if (omits < 0) return 0;
+
+    if (m->fires && m->start == MemoStart && m->ndays == MemoDays) {
+	if (!SameTrigger(&m->trig, trig) || !SameTimeTrig(&m->tim, tim)) {
+	    m->dependent = 1;
+	    return 0;
+	}
+	if (m->omits != omits) {
+	    if (m->builds >= MAX_MEMO_BUILDS) return 0;
+	    BuildCalMemo(m, trig, tim, omits);
+	}
+    } else {
+	m->builds = 0;
+	BuildCalMemo(m, trig, tim, omits);
+    }
+    if (m->failed) return 0;
+
+    return !(m->fires[day / CHAR_BIT] & (1 << (day % CHAR_BIT)));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  BuildCalMemo                                               */
+/*                                                             */
+/*  Work out the days in the window on which a trigger fires.  */
+/*  If that goes wrong, the memo is marked as failed, and the  */
+/*  trigger is computed each day as usual, which knows how to  */
+/*  report it.  The trigger is also computed for today, as it  */
+/*  would be without the memo, so that a trigger which can't  */
+/*  be computed is never memoised and its error is reported   */
+/*  on every day of the calendar.                              */
+/*                                                             */
+/***************************************************************/
+static void BuildCalMemo(CalMemo *m, Trigger const *trig, TimeTrig const *tim, int omits)
+{
+    size_t len = (MemoDays + CHAR_BIT - 1) / CHAR_BIT;
+    int errs = NumErrorsSeen;
+    int suppress = SuppressErrors;
+    Trigger t;
+    TimeTrig tt;
+    int r;
+
+    if (m->fires && m->ndays != MemoDays) {
+	free(m->fires);
+	m->fires = NULL;
+    }
+    if (!m->fires) {
+	m->fires = malloc(len);
+    }
+    m->start = MemoStart;
+    m->ndays = MemoDays;
+    m->omits = omits;
+    m->builds++;
+    memcpy(&m->trig, trig, sizeof(Trigger));
+    DBufInit(&(m->trig.tags));
+    m->tim = *tim;
+    m->failed = 1;
+    if (!m->fires) return;
+    memset(m->fires, 0, len);
+
+    memcpy(&t, trig, sizeof(t));
+    DBufInit(&(t.tags));
+    t.scanfrom = TriggerScanStart(trig, JulianToday);
+    tt = *tim;
+    SuppressErrors = 1;
+    (void) ComputeTrigger(t.scanfrom, &t, &tt, &r, 0);
+    FreeTrig(&t);
+    if (!r) {
+	r = EnumerateTriggers(trig, tim, MemoStart, MemoStart + MemoDays - 1,
+			      0, SetMemoBit, m);
+    }
+    SuppressErrors = suppress;
+    m->failed = (r || NumErrorsSeen != errs);
+    NumErrorsSeen = errs;
+}
+
+static int SetMemoBit(int jul, Trigger *trig, TimeTrig *tim, void *data)
+{
+    CalMemo *m = (CalMemo *) data;
+    int day = jul - m->start;
+
+    UNUSED(trig);
+    UNUSED(tim);
+    m->fires[day / CHAR_BIT] |= (1 << (day % CHAR_BIT));
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SameTrigger                                                */
+/*                                                             */
+/*  Return 1 if two freshly-parsed triggers would be computed  */
+/*  the same way on any day.  The tags don't matter, and the   */
+/*  scan start only does for a fixed SCANFROM date.            */
+/*                                                             */
+/***************************************************************/
+static int SameTrigger(Trigger const *a, Trigger const *b)
+{
+    return a->wd == b->wd &&
+	a->d == b->d &&
+	a->m == b->m &&
+	a->y == b->y &&
+	a->back == b->back &&
+	a->delta == b->delta &&
+	a->rep == b->rep &&
+	a->localomit == b->localomit &&
+	a->skip == b->skip &&
+	a->until == b->until &&
+	a->typ == b->typ &&
+	a->once == b->once &&
+	a->from == b->from &&
+	a->scantype == b->scantype &&
+	(a->scantype != SCAN_FIXED || a->scanfrom == b->scanfrom) &&
+	a->scanback == b->scanback &&
+	a->adj_for_last == b->adj_for_last &&
+	a->need_wkday == b->need_wkday &&
+	a->priority == b->priority &&
+	a->duration_days == b->duration_days &&
+	a->eventstart == b->eventstart &&
+	a->eventduration == b->eventduration &&
+	a->maybe_uncomputable == b->maybe_uncomputable &&
+	a->addomit == b->addomit &&
+	!strcmp(a->sched, b->sched) &&
+	!strcmp(a->warn, b->warn) &&
+	!strcmp(a->omitfunc, b->omitfunc) &&
+	!strcmp(a->passthru, b->passthru);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SameTimeTrig                                               */
+/*                                                             */
+/*  Return 1 if two freshly-parsed time triggers are the same. */
+/*                                                             */
+/***************************************************************/
+static int SameTimeTrig(TimeTrig const *a, TimeTrig const *b)
+{
+    return a->ttime == b->ttime &&
+	a->delta == b->delta &&
+	a->rep == b->rep &&
+	a->duration == b->duration;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CalSatMemo                                                 */
+/*                                                             */
+/*  Return the memo of rejected candidates for the SATISFY     */
+/*  line being processed, so that each day's search can skip   */
+/*  the candidates earlier days' searches already rejected.    */
+/*  The memo is started afresh whenever the window, the        */
+/*  trigger or the OMIT context changes.  Returns NULL if      */
+/*  there can't be a memo.                                     */
+/*                                                             */
+/***************************************************************/
+static SatMemo *CalSatMemo(ParsePtr p, Trigger const *trig, TimeTrig const *tim)
+{
+    CalMemo **slot;
+    CalMemo *m;
+    int omits, day;
+
+    if (!MemoDays || DebugFlag) return NULL;
+    day = JulianToday - MemoStart;
+    if (day < 0 || day >= MemoDays) return NULL;
+
+    /* Lines whose searches have side effects or use OMITFUNCs
+       always have to be searched in full */
+    if (p->isnested || trig->addomit || trig->omitfunc[0]) return NULL;
+
+    omits = OmitContextId();
+    if (omits < 0) return NULL;
+
+    slot = CachedLineMemo();
+    if (!slot) return NULL;
+    m = *slot;
+    if (!m) {
+	m = NEW(CalMemo);
+	if (!m) return NULL;
+	memset(m, 0, sizeof(CalMemo));
+	*slot = m;
+    }
+
+    if (m->start != MemoStart || m->ndays != MemoDays ||
+	m->omits != omits ||
+	!SameTrigger(&m->trig, trig) || !SameTimeTrig(&m->tim, tim)) {
+	m->start = MemoStart;
+	m->ndays = MemoDays;
+	m->omits = omits;
+	memcpy(&m->trig, trig, sizeof(Trigger));
+	DBufInit(&(m->trig.tags));
+	m->tim = *tim;
+	if (m->sat.rejected) free(m->sat.rejected);
+	m->sat.rejected = NULL;
+	m->sat.base = MemoStart;
+	m->sat.ndays = 0;
+    }
+    return &m->sat;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeCalMemo                                                */
+/*                                                             */
+/*  Free a memo when its cached line goes away.                */
+/*                                                             */
+/***************************************************************/
+void FreeCalMemo(CalMemo *m)
+{
+    if (!m) return;
+    if (m->fires) free(m->fires);
+    if (m->sat.rejected) free(m->sat.rejected);
+    free(m);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  MarkRemBody and RewindRemBody                              */
+/*                                                             */
+/*  Remember where the body of a REM starts once its trigger   */
+/*  has been parsed, and go back there so the body can be      */
+/*  processed again for another day.                           */
+/*                                                             */
+/***************************************************************/
+static int MarkRemBody(RemBody *b, ParsePtr p)
+{
+    b->p = p;
+    b->pos = p->pos;
+    b->expr_happened = p->expr_happened;
+    b->nonconst_expr = p->nonconst_expr;
+    DBufInit(&b->pushed);
+    if (p->tokenPushed && DBufPuts(&b->pushed, p->tokenPushed) != OK) {
+	return E_NO_MEM;
+    }
+    return OK;
+}
+
+static void RewindRemBody(RemBody *b)
+{
+    ParsePtr p = b->p;
+
+    if (p->isnested) {
+	free((void *) p->etext);
+	p->etext = NULL;
+	p->epos = NULL;
+	p->isnested = 0;
+    }
+    p->pos = b->pos;
+    p->expr_happened = b->expr_happened;
+    p->nonconst_expr = b->nonconst_expr;
+    DBufFree(&p->pushedToken);
+    p->tokenPushed = NULL;
+    if (DBufLen(&b->pushed)) {
+	DBufPuts(&p->pushedToken, DBufValue(&b->pushed));
+	p->tokenPushed = DBufValue(&p->pushedToken);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CalRemOneDay                                               */
+/*                                                             */
+/*  Called by EnumerateTriggers for each day of the window on  */
+/*  which a REM fires.                                         */
+/*                                                             */
+/***************************************************************/
+static int CalRemOneDay(int jul, Trigger *trig, TimeTrig *tim, void *data)
+{
+    RemBody *b = (RemBody *) data;
+
+    JulianToday = jul;
+    RewindRemBody(b);
+    return FinishCalRem(b->p, trig, tim, jul, &DayEntries[jul - WindowStart]);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoCalRemWindow                                             */
+/*                                                             */
+/*  Do the REM command for every day of the calendar window.   */
+/*  If the trigger does not depend on the date, it is parsed   */
+/*  only once and then computed for each day; otherwise, the   */
+/*  whole line is evaluated once per day, just as it would be  */
+/*  if the script were run separately for each day.            */
+/*                                                             */
+/***************************************************************/
+static int DoCalRemWindow(ParsePtr p)
+{
+    Trigger trig, t;
+    TimeTrig tim, tt, parsed_tt;
+    Parser q;
+    RemBody body;
+    int parsed_time, tt_saved;
+    int i, r;
+
+    /* Parse the trigger as seen from the first day of the window */
+    JulianToday = WindowStart;
+    RestoreTrigState(&DayTrigState[0]);
+    DateDependent = 0;
+    r = ParseRem(p, &trig, &tim, 1);
+    if (r) {
+	FreeTrig(&trig);
+	return r;
+    }
+    CheckTrigStateUse();
+
+    if (DateDependent ||
+	p->isnested ||
+	trig.typ == SAT_TYPE ||
+	trig.omitfunc[0]) {
+	FreeTrig(&trig);
+	for (i=0; i<WindowDays; i++) {
+	    JulianToday = WindowStart + i;
+	    RestoreTrigState(&DayTrigState[i]);
+	    CreateParser(p->text, &q);
+	    DateDependent &= DEP_NUMTRIG;
+	    r = ParseRem(&q, &trig, &tim, 1);
+	    if (r) {
+		FreeTrig(&trig);
+	    } else {
+		CheckTrigStateUse();
+		r = FinishCalRem(&q, &trig, &tim, NO_DATE, &DayEntries[i]);
+	    }
+	    DestroyParser(&q);
+	    SaveTrigState(&DayTrigState[i]);
+	    if (r) return r;
+	}
+	return OK;
+    }
+
+    r = MarkRemBody(&body, p);
+    if (r) {
+	DBufFree(&body.pushed);
+	FreeTrig(&trig);
+	return r;
+    }
+
+    if (!TrigStateNeeded) {
+	/* Nothing looks at the trigger state this line leaves behind,
+	   so only the days on which it fires need to be visited.  If
+	   that goes wrong, fall back to the one-day-at-a-time method,
+	   which knows how to report it. */
+	r = EnumerateTriggers(&trig, &tim, WindowStart,
+			      WindowStart + WindowDays - 1, 1,
+			      CalRemOneDay, &body);
+	if (r) {
+	    SinglePassOK = 0;
+	}
+	DBufFree(&body.pushed);
+	FreeTrig(&trig);
+	return r;
+    }
+
+    /* Otherwise, reproduce exactly what parsing and computing the
+       trigger would have done to the trigger state on each day */
+    parsed_time = LastTriggerTime;
+    parsed_tt = LastTimeTrig;
+    tt_saved = memcmp(&parsed_tt, &DayTrigState[0].tim, sizeof(TimeTrig));
+
+    for (i=0; i<WindowDays; i++) {
+	JulianToday = WindowStart + i;
+	RestoreTrigState(&DayTrigState[i]);
+	LastTriggerTime = parsed_time;
+	if (tt_saved) LastTimeTrig = parsed_tt;
+
+	/* Each day scans with a fresh copy of the trigger */
+	memcpy(&t, &trig, sizeof(t));
+	DBufInit(&(t.tags));
+	DBufPuts(&(t.tags), DBufValue(&(trig.tags)));
+	t.scanfrom = TriggerScanStart(&trig, JulianToday);
+	tt = tim;
+
+	RewindRemBody(&body);
+	r = FinishCalRem(p, &t, &tt, NO_DATE, &DayEntries[i]);
+	SaveTrigState(&DayTrigState[i]);
+	if (r) break;
+    }
+    DBufFree(&body.pushed);
+    FreeTrig(&trig);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CheckTrigStateUse                                          */
+/*                                                             */
+/*  If the trigger just parsed looked at the trigger state     */
+/*  left by earlier lines but the priming run decided that     */
+/*  nothing does, the single pass can't be trusted.            */
+/*                                                             */
+/***************************************************************/
+static void CheckTrigStateUse(void)
+{
+    if ((DateDependent & DEP_TRIG) && !TrigStateNeeded) {
+	SinglePassOK = 0;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  NoteTrigStateUse                                           */
+/*                                                             */
+/*  Something looked at the trigger state left by earlier      */
+/*  lines, so it has to be exact from now on.  If a memo has   */
+/*  already let a trigger go uncomputed today, the state seen  */
+/*  may have been stale, and the day must be done again.       */
+/*                                                             */
+/***************************************************************/
+static void NoteTrigStateUse(void)
+{
+    if (!TrigStateNeeded) {
+	TrigStateNeeded = 1;
+	if (TrigsSkipped) RedoDay = 1;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FinishCalRem                                               */
+/*                                                             */
+/*  Given a parsed trigger, compute it and add an entry to     */
+/*  the calendar column col if it triggers today.  If col is   */
+/*  NULL, just compute the trigger.  If jul is not NO_DATE,    */
+/*  the trigger has already been computed and fires on jul.    */
+/*  Frees the trigger.                                         */
+/*                                                             */
+/***************************************************************/
+static int FinishCalRem(ParsePtr p, Trigger *trig, TimeTrig *tim, int jul, CalEntry **col)
+{
+    size_t oldLen;
     Value v;
     int r, err;
-    int jul;
-    CalEntry *CurCol;
     CalEntry *e;
     char const *s, *s2;
     DynamicBuffer buf, obuf, pre_buf, raw_buf;
@@ -1512,25 +2459,14 @@ static int DoCalRem(ParsePtr p, int col)
 
     int is_color, col_r, col_g, col_b;
 
-    if (col >= 0) {
-        CurCol = CalColumn[col];
-    } else {
-        CurCol = NULL;
-    }
     is_color = 0;
     DBufInit(&buf);
     DBufInit(&pre_buf);
     DBufInit(&raw_buf);
 
-    /* Parse the trigger date and time */
-    if ( (r=ParseRem(p, &trig, &tim, 1)) ) {
-	FreeTrig(&trig);
-	return r;
-    }
-
-    if (trig.typ == MSG_TYPE ||
-	trig.typ == CAL_TYPE ||
-	trig.typ == MSF_TYPE) {
+    if (trig->typ == MSG_TYPE ||
+	trig->typ == CAL_TYPE ||
+	trig->typ == MSF_TYPE) {
 	is_color = (
 	    DefaultColorR != -1
 	    && DefaultColorG != -1
@@ -1542,37 +2478,37 @@ static int DoCalRem(ParsePtr p, int col)
 	}
     }
 
-    if (trig.typ == NO_TYPE) {
-	FreeTrig(&trig);
+    if (trig->typ == NO_TYPE) {
+	FreeTrig(trig);
 	return E_EOLN;
     }
-    if (trig.typ == SAT_TYPE) {
-	r=DoSatRemind(&trig, &tim, p);
+    if (trig->typ == SAT_TYPE) {
+	r=DoSatRemind(trig, tim, p, CalSatMemo(p, trig, tim));
 	if (r) {
-            if (r == E_CANT_TRIG && trig.maybe_uncomputable) {
+            if (r == E_CANT_TRIG && trig->maybe_uncomputable) {
                 r = OK;
             }
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    if (r == E_EXPIRED) return OK;
 	    return r;
 	}
 	if (!LastTrigValid) {
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return OK;
 	}
 	r=ParseToken(p, &buf);
 	if (r) {
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return r;
 	}
 	FindToken(DBufValue(&buf), &tok);
 	DBufFree(&buf);
 	if (tok.type == T_Empty || tok.type == T_Comment) {
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return OK;
 	}
 	if (tok.type != T_RemType || tok.val == SAT_TYPE) {
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return E_PARSE_ERR;
 	}
 	if (tok.val == PASSTHRU_TYPE) {
@@ -1580,82 +2516,85 @@ static int DoCalRem(ParsePtr p, int col)
 	    if (r) return r;
 	    if (!DBufLen(&buf)) {
 		DBufFree(&buf);
-		FreeTrig(&trig);
+		FreeTrig(trig);
 		return E_EOLN;
 	    }
-	    StrnCpy(trig.passthru, DBufValue(&buf), PASSTHRU_LEN);
+	    StrnCpy(trig->passthru, DBufValue(&buf), PASSTHRU_LEN);
 	    DBufFree(&buf);
 	}
-	trig.typ = tok.val;
+	trig->typ = tok.val;
 	jul = LastTriggerDate;
 	if (!LastTrigValid) {
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return OK;
 	}
-    } else {
+    } else if (jul == NO_DATE) {
 	/* Calculate the trigger date */
-	jul = ComputeTrigger(trig.scanfrom, &trig, &tim, &r, 1);
+	jul = ComputeTrigger(trig->scanfrom, trig, tim, &r, 1);
 	if (r) {
-            if (r == E_CANT_TRIG && trig.maybe_uncomputable) {
+            if (r == E_CANT_TRIG && trig->maybe_uncomputable) {
                 r = OK;
             }
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return r;
 	}
     }
 
-    /* Add to global OMITs if so indicated */
-    if (trig.addomit) {
+    /* Add to global OMITs if so indicated.  This changes the OMIT
+       context seen by later lines from one day to the next, so the
+       calendar has to be generated one day at a time. */
+    if (trig->addomit) {
+        SinglePassOK = 0;
         r = AddGlobalOmit(jul);
         if (r) {
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
             return r;
         }
     }
 
     /* If we're not actually generating any calendar entries, we're done */
-    if (col < 0) {
-	FreeTrig(&trig);
+    if (!col) {
+	FreeTrig(trig);
         return OK;
     }
 
     /* Don't include timed reminders in calendar if -a option supplied. */
-    if (DontIssueAts && tim.ttime != NO_TIME) {
-	FreeTrig(&trig);
+    if (DontIssueAts && tim->ttime != NO_TIME) {
+	FreeTrig(trig);
 	return OK;
     }
 
     /* Save nonconst_expr flag */
     nonconst_expr = p->nonconst_expr;
     /* Convert PS and PSF to PASSTHRU */
-    if (trig.typ == PS_TYPE) {
-	strcpy(trig.passthru, "PostScript");
-	trig.typ = PASSTHRU_TYPE;
-    } else if (trig.typ == PSF_TYPE) {
-	strcpy(trig.passthru, "PSFile");
-	trig.typ = PASSTHRU_TYPE;
+    if (trig->typ == PS_TYPE) {
+	strcpy(trig->passthru, "PostScript");
+	trig->typ = PASSTHRU_TYPE;
+    } else if (trig->typ == PSF_TYPE) {
+	strcpy(trig->passthru, "PSFile");
+	trig->typ = PASSTHRU_TYPE;
     }
 
     /* If it's a plain reminder but we have a default color, add the
        three colors to the prebuf and change passthru to "COLOR" */
-    if (trig.typ == MSG_TYPE ||
-	trig.typ == CAL_TYPE ||
-	trig.typ == MSF_TYPE) {
+    if (trig->typ == MSG_TYPE ||
+	trig->typ == CAL_TYPE ||
+	trig->typ == MSF_TYPE) {
 	if (PsCal && is_color) {
 	    char cbuf[24];
 	    sprintf(cbuf, "%d %d %d ", col_r, col_g, col_b);
 	    DBufPuts(&pre_buf, cbuf);
-	    strcpy(trig.passthru, "COLOR");
-	    /* Don't change trig.typ or next if() will trigger! */
+	    strcpy(trig->passthru, "COLOR");
+	    /* Don't change trig->typ or next if() will trigger! */
 	}
     }
-    if (trig.typ == PASSTHRU_TYPE) {
-	if (!PsCal && StrCmpi(trig.passthru, "COLOR") && StrCmpi(trig.passthru, "COLOUR")) {
-	    FreeTrig(&trig);
+    if (trig->typ == PASSTHRU_TYPE) {
+	if (!PsCal && StrCmpi(trig->passthru, "COLOR") && StrCmpi(trig->passthru, "COLOUR")) {
+	    FreeTrig(trig);
 	    return OK;
 	}
-	if (!StrCmpi(trig.passthru, "COLOR") ||
-	    !StrCmpi(trig.passthru, "COLOUR")) {
+	if (!StrCmpi(trig->passthru, "COLOR") ||
+	    !StrCmpi(trig->passthru, "COLOUR")) {
 	    is_color = 1;
 	    /* Strip off the three color numbers */
 	    DBufFree(&buf);
@@ -1664,7 +2603,7 @@ static int DoCalRem(ParsePtr p, int col)
 	    DBufPutc(&pre_buf, ' ');
 	    DBufFree(&buf);
 	    if (r) {
-		FreeTrig(&trig);
+		FreeTrig(trig);
 		return r;
 	    }
 	    r=ParseToken(p, &buf);
@@ -1672,7 +2611,7 @@ static int DoCalRem(ParsePtr p, int col)
 	    DBufPutc(&pre_buf, ' ');
 	    DBufFree(&buf);
 	    if (r) {
-		FreeTrig(&trig);
+		FreeTrig(trig);
 		return r;
 	    }
 	    r=ParseToken(p, &buf);
@@ -1680,7 +2619,7 @@ static int DoCalRem(ParsePtr p, int col)
 	    DBufPutc(&pre_buf, ' ');
 	    DBufFree(&buf);
 	    if (r) {
-		FreeTrig(&trig);
+		FreeTrig(trig);
 		return r;
 	    }
 	    (void) sscanf(DBufValue(&pre_buf), "%d %d %d",
@@ -1701,7 +2640,7 @@ static int DoCalRem(ParsePtr p, int col)
     DBufInit(&obuf);
     if ((jul == JulianToday) ||
 	(DoSimpleCalDelta &&
-	 ShouldTriggerReminder(&trig, &tim, jul, &err))) {
+	 ShouldTriggerReminder(trig, tim, jul, &err))) {
 	NumTriggered++;
 
 	/* The parse_ptr should not be nested, but just in case... */
@@ -1709,37 +2648,37 @@ static int DoCalRem(ParsePtr p, int col)
 	    if (DBufPuts(&raw_buf, p->pos) != OK) {
 		DBufFree(&obuf);
 		DBufFree(&pre_buf);
-		FreeTrig(&trig);
+		FreeTrig(trig);
 		return E_NO_MEM;
 	    }
 	}
-	if (DoSimpleCalendar || tim.ttime != NO_TIME) {
+	if (DoSimpleCalendar || tim->ttime != NO_TIME) {
 	    /* Suppress time if it's not today or if it's a non-COLOR special */
 	    if (jul != JulianToday ||
-		(trig.typ == PASSTHRU_TYPE &&
-		 StrCmpi(trig.passthru, "COLOUR") &&
-		 StrCmpi(trig.passthru, "COLOR"))) {
+		(trig->typ == PASSTHRU_TYPE &&
+		 StrCmpi(trig->passthru, "COLOUR") &&
+		 StrCmpi(trig->passthru, "COLOR"))) {
 		if (DBufPuts(&obuf, SimpleTime(NO_TIME)) != OK) {
 		    DBufFree(&obuf);
 		    DBufFree(&raw_buf);
 		    DBufFree(&pre_buf);
-		    FreeTrig(&trig);
+		    FreeTrig(trig);
 		    return E_NO_MEM;
 		}
 	    } else {
-		if (DBufPuts(&obuf, CalendarTime(tim.ttime, tim.duration)) != OK) {
+		if (DBufPuts(&obuf, CalendarTime(tim->ttime, tim->duration)) != OK) {
 		    DBufFree(&raw_buf);
 		    DBufFree(&obuf);
 		    DBufFree(&pre_buf);
-		    FreeTrig(&trig);
+		    FreeTrig(trig);
 		    return E_NO_MEM;
 		}
 	    }
 	}
-	if (trig.typ != PASSTHRU_TYPE &&
+	if (trig->typ != PASSTHRU_TYPE &&
 	    UserFuncExists("calprefix")==1) {
 	    char evalBuf[64];
-	    sprintf(evalBuf, "calprefix(%d)", trig.priority);
+	    sprintf(evalBuf, "calprefix(%d)", trig->priority);
 	    s2 = evalBuf;
 	    r = EvalExpr(&s2, &v, NULL);
 	    if (!r) {
@@ -1749,7 +2688,7 @@ static int DoCalRem(ParsePtr p, int col)
 			DBufFree(&raw_buf);
 			DBufFree(&obuf);
 			DBufFree(&pre_buf);
-			FreeTrig(&trig);
+			FreeTrig(trig);
 			return E_NO_MEM;
 		    }
 		}
@@ -1761,28 +2700,28 @@ static int DoCalRem(ParsePtr p, int col)
 	/* In -sa mode, run in ADVANCE mode if we're triggering
 	 * before the actual date */
 	if (jul != JulianToday) {
-	    r = DoSubst(p, &obuf, &trig, &tim, jul, ADVANCE_MODE);
+	    r = DoSubst(p, &obuf, trig, tim, jul, ADVANCE_MODE);
 	} else {
-	    r = DoSubst(p, &obuf, &trig, &tim, jul, CAL_MODE);
+	    r = DoSubst(p, &obuf, trig, tim, jul, CAL_MODE);
 	}
 	if (r) {
 	    DBufFree(&pre_buf);
 	    DBufFree(&obuf);
 	    DBufFree(&raw_buf);
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return r;
 	}
 	if (DBufLen(&obuf) <= oldLen) {
 	    DBufFree(&obuf);
 	    DBufFree(&pre_buf);
 	    DBufFree(&raw_buf);
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return OK;
 	}
-	if (trig.typ != PASSTHRU_TYPE &&
+	if (trig->typ != PASSTHRU_TYPE &&
 	    UserFuncExists("calsuffix")==1) {
 	    char evalBuf[64];
-	    sprintf(evalBuf, "calsuffix(%d)", trig.priority);
+	    sprintf(evalBuf, "calsuffix(%d)", trig->priority);
 	    s2 = evalBuf;
 	    r = EvalExpr(&s2, &v, NULL);
 	    if (!r) {
@@ -1792,7 +2731,7 @@ static int DoCalRem(ParsePtr p, int col)
 			DBufFree(&raw_buf);
 			DBufFree(&obuf);
 			DBufFree(&pre_buf);
-			FreeTrig(&trig);
+			FreeTrig(trig);
 			return E_NO_MEM;
 		    }
 		}
@@ -1808,13 +2747,13 @@ static int DoCalRem(ParsePtr p, int col)
 	    DBufFree(&obuf);
 	    DBufFree(&raw_buf);
 	    DBufFree(&pre_buf);
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return E_NO_MEM;
 	}
 	e->nonconst_expr = nonconst_expr;
 	e->if_depth = NumIfs;
-	e->trig = trig;
-	e->tt = tim;
+	e->trig = *trig;
+	e->tt = *tim;
 #ifdef REM_USE_WCHAR
 	e->wc_pos = NULL;
 	e->wc_text = NULL;
@@ -1832,20 +2771,20 @@ static int DoCalRem(ParsePtr p, int col)
 	    if (e->text) free(e->text);
 	    if (e->raw_text) free(e->raw_text);
 	    free(e);
-	    FreeTrig(&trig);
+	    FreeTrig(trig);
 	    return E_NO_MEM;
 	}
 	make_wchar_versions(e);
 	DBufInit(&(e->tags));
-	DBufPuts(&(e->tags), DBufValue(&(trig.tags)));
+	DBufPuts(&(e->tags), DBufValue(&(trig->tags)));
 	if (SynthesizeTags) {
 	    AppendTag(&(e->tags), SynthesizeTag());
 	}
 
 	/* Don't need tags any more */
-	FreeTrig(&trig);
-	e->duration = tim.duration;
-	e->priority = trig.priority;
+	FreeTrig(trig);
+	e->duration = tim->duration;
+	e->priority = trig->priority;
 	e->filename = StrDup(FileName);
 	if(!e->filename) {
 	    if (e->text) free(e->text);
@@ -1858,20 +2797,20 @@ static int DoCalRem(ParsePtr p, int col)
 	}
 	e->lineno = LineNo;
 
-	if (trig.typ == PASSTHRU_TYPE || is_color) {
-	    StrnCpy(e->passthru, trig.passthru, PASSTHRU_LEN);
+	if (trig->typ == PASSTHRU_TYPE || is_color) {
+	    StrnCpy(e->passthru, trig->passthru, PASSTHRU_LEN);
 	} else {
 	    e->passthru[0] = 0;
 	}
 	e->pos = e->text;
 	if (jul == JulianToday) {
-	    e->time = tim.ttime;
+	    e->time = tim->ttime;
 	} else {
 	    e->time = NO_TIME;
 	}
-	e->next = CurCol;
-	CalColumn[col] = e;
-	SortCol(&CalColumn[col]);
+	e->next = *col;
+	*col = e;
+	SortCol(col);
     } else {
         /* Parse the rest of the line to catch expression-pasting errors */
         while (ParseChar(p, &r, 0)) {
@@ -2047,16 +2986,14 @@ static void WriteSimpleEntryProtocol2(CalEntry *e, int today)
 /*                                                             */
 /*  WriteSimpleEntries                                         */
 /*                                                             */
-/*  Write entries in 'simple calendar' format.                 */
+/*  Write entries in 'simple calendar' format.  The caller     */
+/*  supplies jul already converted to y, m and d.              */
 /*                                                             */
 /***************************************************************/
-static void WriteSimpleEntries(int col, int jul)
+static void WriteSimpleEntries(int col, int jul, int y, int m, int d)
 {
     CalEntry *e = CalColumn[col];
     CalEntry *n;
-    int y, m, d;
-
-    FromJulian(jul, &y, &m, &d);
     while(e) {
 	if (DoPrefixLineNo) {
 	    if (PsCal != PSCAL_LEVEL2 && PsCal != PSCAL_LEVEL3) {
@@ -0,0 +1,60 @@
+/* src/config.h.  Generated from config.h.in by configure.  */
+/* Define if utime(file, NULL) sets file's timestamp to the present.  */
+#define HAVE_UTIME_NULL 1
+
+/* Define if you can safely include both <sys/time.h> and <time.h>.  */
+#define TIME_WITH_SYS_TIME 1
+
+/* Define if your <sys/time.h> declares struct tm.  */
+/* #undef TM_IN_SYS_TIME */
+
+/* Define if you have the <sys/file.h> header file.  */
+#define HAVE_SYS_FILE_H 1
+
+/* Define if you have the <sys/types.h> header file.  */
+#define HAVE_SYS_TYPES_H 1
+
+/* Define if you have the <glob.h> header file */
+#define HAVE_GLOB_H 1
+
+#define HAVE_WCTYPE_H 1
+
+#define HAVE_LOCALE_H 1
+
+#define HAVE_LANGINFO_H 1
+
+#define HAVE_SYS_INOTIFY_H 1
+
+#define HAVE_SYS_EPOLL_H 1
+
+#define HAVE_SYS_TIMERFD_H 1
+
+#define HAVE_SYS_MMAN_H 1
+
+#define HAVE_GLOB 1
+
+#define HAVE_SETENV 1
+
+#define HAVE_INITGROUPS 1
+
+#define HAVE_UNSETENV 1
+
+#define HAVE_MBSTOWCS 1
+
+#define HAVE_SETLOCALE 1
+
+#define HAVE_INOTIFY_INIT1 1
+
+#define HAVE_EPOLL_CREATE1 1
+
+#define HAVE_TIMERFD_CREATE 1
+
+#define HAVE_MMAP 1
+
+/* The number of bytes in a unsigned int.  */
+#define SIZEOF_UNSIGNED_INT 4
+
+/* The number of bytes in a unsigned long.  */
+#define SIZEOF_UNSIGNED_LONG 8
+
+#include "custom.h"
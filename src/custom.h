@@ -134,16 +134,6 @@
 /*---------------------------------------------------------------------*/
 #define TRIG_ATTEMPTS 500
 
-/*---------------------------------------------------------------------*/
-/* How many global omits of the form YYYY MM DD do we handle?          */
-/*---------------------------------------------------------------------*/
-#define MAX_FULL_OMITS 1000
-
-/*---------------------------------------------------------------------*/
-/* How many global omits of the form MM DD do we handle?               */
-/*---------------------------------------------------------------------*/
-#define MAX_PARTIAL_OMITS 366
-
 /*---------------------------------------------------------------------*/
 /* A newline - some systems need "\n\r"                                */
 /*---------------------------------------------------------------------*/
@@ -154,6 +144,14 @@
 /*---------------------------------------------------------------------*/
 #define CAL_LINES 5
 
+/*---------------------------------------------------------------------*/
+/* ZONEINFO_DIR: Where to find compiled time-zone files if $TZDIR is   */
+/* not set.  LOCALTIME_FILE: The zone file for local time if $TZ is    */
+/* not set.                                                            */
+/*---------------------------------------------------------------------*/
+#define ZONEINFO_DIR "/usr/share/zoneinfo"
+#define LOCALTIME_FILE "/etc/localtime"
+
 /*---------------------------------------------------------------------*/
 /* Don't change the next definitions                                   */
 /*---------------------------------------------------------------------*/
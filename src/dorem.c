@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <limits.h>
 
 #include <stdlib.h>
 
@@ -31,6 +32,14 @@ static int ParsePriority (ParsePtr s, Trigger *t);
 static int ParseUntil (ParsePtr s, Trigger *t, int type);
 static int ShouldTriggerBasedOnWarn (Trigger *t, int jul, int *err);
 static int ComputeTrigDuration(TimeTrig *t);
+static int SatisfySearch (Trigger *trig, TimeTrig *tt, ParsePtr p, CompiledExpr *c, SatMemo *memo);
+static CompiledExpr *CompileSatExpr (ParsePtr p, int *own);
+static int EvaluateSatExpr (ParsePtr p, Value *v, CompiledExpr *c);
+static int SatRejected (SatMemo const *m, int jul);
+static void NoteSatRejected (SatMemo *m, int jul);
+
+/* Most days a SatMemo will cover */
+#define MAX_SAT_MEMO_DAYS 65536
 
 static int
 ComputeTrigDuration(TimeTrig *t)
@@ -75,7 +84,7 @@ int DoRem(ParsePtr p)
     if (trig.typ == SAT_TYPE) {
 	PurgeEchoLine("%s\n", "#!P: Cannot purge SATISFY-type reminders");
 	PurgeEchoLine("%s\n", CurLine);
-	r=DoSatRemind(&trig, &tim, p);
+	r=DoSatRemind(&trig, &tim, p, NULL);
 	if (r) {
             if (r == E_CANT_TRIG && trig.maybe_uncomputable) {
                 r = OK;
@@ -233,6 +242,8 @@ int ParseRem(ParsePtr s, Trigger *trig, TimeTrig *tim, int save_in_globals)
     trig->typ = NO_TYPE;
     trig->scanfrom = NO_DATE;
     trig->from = NO_DATE;
+    trig->scantype = SCAN_TODAY;
+    trig->scanback = 0;
     trig->priority = DefaultPrio;
     trig->sched[0] = 0;
     trig->warn[0] = 0;
@@ -753,7 +764,8 @@ static int ParseScanFrom(ParsePtr s, Trigger *t, int type)
 {
     int y = NO_YR,
 	m = NO_MON,
-	d = NO_DAY;
+	d = NO_DAY,
+	back = -1;
 
     Token tok;
     int r;
@@ -839,6 +851,7 @@ static int ParseScanFrom(ParsePtr s, Trigger *t, int type)
 	    if (tok.val < 0) {
 		tok.val = -tok.val;
 	    }
+	    back = tok.val;
 	    FromJulian(JulianToday - tok.val, &y, &m, &d);
 	    break;
 
@@ -855,11 +868,18 @@ static int ParseScanFrom(ParsePtr s, Trigger *t, int type)
 	    t->scanfrom = Julian(y, m, d);
 	    if (type == FROM_TYPE) {
 		t->from = t->scanfrom;
+		t->scantype = SCAN_FROM;
 		if (t->scanfrom < JulianToday) {
 		    t->scanfrom = JulianToday;
 		}
 	    } else {
 		t->from = NO_DATE;
+		if (back >= 0) {
+		    t->scantype = SCAN_BACK;
+		    t->scanback = back;
+		} else {
+		    t->scantype = SCAN_FIXED;
+		}
 	    }
 
 	    PushToken(DBufValue(&buf), s);
@@ -1130,7 +1150,7 @@ int TriggerReminder(ParsePtr p, Trigger *t, TimeTrig *tim, int jul)
 /***************************************************************/
 int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
 {
-    int r, omit;
+    int r;
     *err = 0;
 
     /* Handle the ONCE modifier in the reminder. */
@@ -1178,23 +1198,23 @@ int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
 	if (t->delta < 0)
 	    jul = jul + t->delta;
 	else {
-	    int iter = 0;
 	    int max = MaxSatIter;
+	    int avail = jul - JulianToday;
+	    int steps;
 	    r = t->delta;
 	    if (max < r*2) max = r*2;
-	    while(iter++ < max) {
-		if (!r || (jul <= JulianToday)) {
-		    break;
-		}
-		jul--;
-		*err = IsOmitted(jul, t->localomit, t->omitfunc, &omit);
+	    /* Never back up past today */
+	    if (avail > 0) {
+		*err = NonOmittedSteps(jul-1, -1, r, t->localomit, t->omitfunc,
+				       (avail < max) ? avail : max, &steps);
 		if (*err) return 0;
-		if (!omit) r--;
-	    }
-	    if (iter > max) {
-		*err = E_CANT_TRIG;
-	        Eprint("Delta: Bad OMITFUNC? %s", ErrMsg[E_CANT_TRIG]);
-		return 0;
+		if (steps > avail) steps = avail;
+		if (steps >= max) {
+		    *err = E_CANT_TRIG;
+		    Eprint("Delta: Bad OMITFUNC? %s", ErrMsg[E_CANT_TRIG]);
+		    return 0;
+		}
+		jul -= steps;
 	    }
 	}
     }
@@ -1207,12 +1227,42 @@ int ShouldTriggerReminder(Trigger *t, TimeTrig *tim, int jul, int *err)
 /*                                                             */
 /*  DoSatRemind                                                */
 /*                                                             */
-/*  Do the "satisfying..." remind calculation.                 */
+/*  Do the "satisfying..." remind calculation.  The expression */
+/*  is compiled once and run for each candidate date.  If memo */
+/*  isn't NULL, candidates it records as rejected aren't tried */
+/*  again, and newly rejected ones are added to it; the caller */
+/*  must make sure it was built for the same trigger and OMIT  */
+/*  context.                                                   */
+/*                                                             */
+/***************************************************************/
+int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p, SatMemo *memo)
+{
+    CompiledExpr *c;
+    int own, r;
+
+    c = CompileSatExpr(p, &own);
+
+    /* Rejections can only be remembered if the expression depends
+       on nothing but the candidate */
+    if (memo && (!c || !CompiledExprSelfContained(c))) {
+	memo = NULL;
+    }
+    r = SatisfySearch(trig, tt, p, c, memo);
+    if (own) FreeCompiledExpr(c);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SatisfySearch                                              */
+/*                                                             */
+/*  Try candidate dates for DoSatRemind() until the expression */
+/*  is satisfied.                                              */
 /*                                                             */
 /***************************************************************/
-int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p)
+static int SatisfySearch(Trigger *trig, TimeTrig *tt, ParsePtr p, CompiledExpr *c, SatMemo *memo)
 {
-    int iter, jul, r, start;
+    int iter, jul, r, start, ok, dep, errs;
     Value v;
     char const *s;
     char const *t;
@@ -1243,12 +1293,33 @@ int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p)
 	    return E_EXPIRED;
 	}
 	s = p->pos;
-	r = EvaluateExpr(p, &v);
-	t = p->pos;
-	if (r) return r;
-	if (v.type != INT_TYPE && v.type != STR_TYPE) return E_BAD_TYPE;
-	if ((v.type == INT_TYPE && v.v.val) ||
-	    (v.type == STR_TYPE && *v.v.str)) {
+	if (memo && SatRejected(memo, jul)) {
+	    ok = 0;
+	} else {
+	    errs = NumErrorsSeen;
+	    dep = DateDependent;
+	    DateDependent = 0;
+	    r = EvaluateSatExpr(p, &v, c);
+	    t = p->pos;
+	    if (r) {
+		DateDependent |= dep;
+		return r;
+	    }
+	    if (v.type != INT_TYPE && v.type != STR_TYPE) {
+		DestroyValue(v);
+		DateDependent |= dep;
+		return E_BAD_TYPE;
+	    }
+	    ok = ((v.type == INT_TYPE && v.v.val) ||
+		  (v.type == STR_TYPE && *v.v.str));
+	    DestroyValue(v);
+	    if (memo && !ok && !(DateDependent & DEP_TODAY) &&
+		NumErrorsSeen == errs) {
+		NoteSatRejected(memo, jul);
+	    }
+	    DateDependent |= dep;
+	}
+	if (ok) {
 	    AdjustTriggerForDuration(trig->scanfrom, jul, trig, tt, 1);
 	    if (DebugFlag & DB_PRTTRIG) {
 		int y, m, d;
@@ -1285,6 +1356,102 @@ int DoSatRemind(Trigger *trig, TimeTrig *tt, ParsePtr p)
     return E_CANT_TRIG;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  CompileSatExpr                                             */
+/*                                                             */
+/*  Compile the expression at p->pos.  If it comes from a      */
+/*  cached line, the cached compiled form is used; otherwise   */
+/*  *own is set and the caller must free the result.  Returns  */
+/*  NULL if the expression can't be compiled.                  */
+/*                                                             */
+/***************************************************************/
+static CompiledExpr *CompileSatExpr(ParsePtr p, int *own)
+{
+    char const *s = p->pos;
+    CompiledExpr *c;
+
+    *own = 0;
+    if (p->isnested) return NULL;
+    while (isempty(*s)) s++;
+    if (*s == BEG_OF_EXPR) s++;
+    c = CachedExpr(s);
+    if (!c) {
+	c = CompileExpr(s, NULL);
+	*own = (c != NULL);
+    }
+    return c;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  EvaluateSatExpr                                            */
+/*                                                             */
+/*  Like EvaluateExpr(), but run c if it isn't NULL.           */
+/*                                                             */
+/***************************************************************/
+static int EvaluateSatExpr(ParsePtr p, Value *v, CompiledExpr *c)
+{
+    int bracketed = 0;
+    int r;
+
+    if (!c) return EvaluateExpr(p, v);
+    while (isempty(*p->pos)) (p->pos)++;
+    if (*p->pos == BEG_OF_EXPR) {
+	(p->pos)++;
+	bracketed = 1;
+    }
+    r = EvalCompiledExpr(c, &(p->pos), v, p);
+    if (r) return r;
+    if (bracketed) {
+	if (*p->pos != END_OF_EXPR) return E_MISS_END;
+	(p->pos)++;
+    }
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SatRejected                                                */
+/*                                                             */
+/*  Return non-zero if m records jul as rejected.              */
+/*                                                             */
+/***************************************************************/
+static int SatRejected(SatMemo const *m, int jul)
+{
+    int i = jul - m->base;
+
+    if (i < 0 || i >= m->ndays) return 0;
+    return m->rejected[i / CHAR_BIT] & (1 << (i % CHAR_BIT));
+}
+
+/***************************************************************/
+/*                                                             */
+/*  NoteSatRejected                                            */
+/*                                                             */
+/*  Record jul in m as rejected, growing m as needed.  Dates   */
+/*  m can't cover are simply not recorded.                     */
+/*                                                             */
+/***************************************************************/
+static void NoteSatRejected(SatMemo *m, int jul)
+{
+    int i = jul - m->base;
+    int n;
+    unsigned char *r;
+
+    if (i < 0 || i >= MAX_SAT_MEMO_DAYS) return;
+    if (i >= m->ndays) {
+	n = m->ndays ? m->ndays : 256;
+	while (n <= i) n *= 2;
+	r = realloc(m->rejected, n / CHAR_BIT);
+	if (!r) return;
+	memset(r + m->ndays / CHAR_BIT, 0, (n - m->ndays) / CHAR_BIT);
+	m->rejected = r;
+	m->ndays = n;
+    }
+    m->rejected[i / CHAR_BIT] |= (1 << (i % CHAR_BIT));
+}
+
 /***************************************************************/
 /*                                                             */
 /*  ParsePriority - parse the PRIORITY portion of a reminder   */
@@ -1389,7 +1556,7 @@ static int ShouldTriggerBasedOnWarn(Trigger *t, int jul, int *err)
     char buffer[VAR_NAME_LEN+32];
     int i;
     char const *s;
-    int r, omit;
+    int r;
     Value v;
     int lastReturnVal = 0; /* Silence compiler warning */
 
@@ -1426,24 +1593,17 @@ static int ShouldTriggerBasedOnWarn(Trigger *t, int jul, int *err)
 	if (v.v.val >= 0) {
 	    if (JulianToday + v.v.val == jul) return 1;
 	} else {
-	    int j = jul;
-	    int iter = 0;
+	    int steps;
 	    int max = MaxSatIter;
 	    if (max < v.v.val * 2) max = v.v.val*2;
-	    while(iter++ <= max) {
-		j--;
-		*err = IsOmitted(j, t->localomit, t->omitfunc, &omit);
-		if (*err) return 0;
-		if (!omit) v.v.val++;
-		if (!v.v.val) {
-		    break;
-		}
-	    }
-	    if (iter > max) {
+	    *err = NonOmittedSteps(jul-1, -1, -v.v.val, t->localomit,
+				   t->omitfunc, max, &steps);
+	    if (*err) return 0;
+	    if (steps > max) {
 	        Eprint("Delta: Bad OMITFUNC? %s", ErrMsg[E_CANT_TRIG]);
 	        return 0;
 	    }
-	    if (j == JulianToday) return 1;
+	    if (jul - steps == JulianToday) return 1;
 	}
     }
 }
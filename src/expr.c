@@ -41,6 +41,8 @@ static int Multiply(void), Divide(void), Mod(void), Add(void),
     Compare(int);
 
 static int MakeValue (char const *s, Value *v, Var *locals, ParsePtr p);
+static int ParseExprToken (DynamicBuffer *buf, char const **in);
+static int ReadExprToken (DynamicBuffer *buf, char const **in);
 
 /* Binary operators - all left-associative */
 
@@ -154,10 +156,27 @@ static char PeekChar(char const **s)
 /*                                                             */
 /*  ParseExprToken                                             */
 /*                                                             */
-/*  Read a token.                                              */
+/*  Read a token, complaining about illegal characters.        */
 /*                                                             */
 /***************************************************************/
 static int ParseExprToken(DynamicBuffer *buf, char const **in)
+{
+    int r = ReadExprToken(buf, in);
+
+    if (r == E_ILLEGAL_CHAR) {
+	Eprint("%s `%c'", ErrMsg[E_ILLEGAL_CHAR], *(*in - 1));
+    }
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ReadExprToken                                              */
+/*                                                             */
+/*  Read a token without issuing any messages.                 */
+/*                                                             */
+/***************************************************************/
+static int ReadExprToken(DynamicBuffer *buf, char const **in)
 {
 
     char c;
@@ -284,7 +303,6 @@ static int ParseExprToken(DynamicBuffer *buf, char const **in)
     }
 
     if (!ISID(c) && c != '$') {
-	Eprint("%s `%c'", ErrMsg[E_ILLEGAL_CHAR], c);
 	return E_ILLEGAL_CHAR;
     }
 
@@ -318,13 +336,28 @@ static int ParseExprToken(DynamicBuffer *buf, char const **in)
 /*                                                             */
 /***************************************************************/
 int EvalExpr(char const **e, Value *v, ParsePtr p)
+{
+    /* Expressions in cached lines are compiled the first time
+       they're evaluated */
+    return EvalCompiledExpr(CachedExpr(*e), e, v, p);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  EvalCompiledExpr                                           */
+/*                                                             */
+/*  Like EvalExpr(), but run c, which must have been compiled  */
+/*  from *e; if c is NULL, the expression is parsed as usual.  */
+/*                                                             */
+/***************************************************************/
+int EvalCompiledExpr(CompiledExpr *c, char const **e, Value *v, ParsePtr p)
 {
     int r;
 
     int old_op_stack_ptr = OpStackPtr;
     int old_val_stack_ptr = ValStackPtr;
 
-    r = Evaluate(e, NULL, p);
+    r = EvaluateCompiled(c, e, NULL, p);
 
     /* Put last character parsed back onto input stream */
     if (DBufLen(&ExprBuf)) (*e)--;
@@ -1393,3 +1426,497 @@ int FnPopValStack(Value *val)
 	return OK;
     }
 }
+
+/***************************************************************/
+/*                                                             */
+/*  Compiled expressions                                       */
+/*                                                             */
+/*  An expression can be compiled once into a list of          */
+/*  instructions in the order in which Evaluate() would carry  */
+/*  out the corresponding actions, and then run any number of  */
+/*  times without being re-tokenized.  Running the compiled    */
+/*  form has exactly the same effects as Evaluate(), including */
+/*  error messages, side-effects of function calls, operator-  */
+/*  and value-stack usage and where the input is left          */
+/*  afterwards.  Anything Evaluate() would reject as a syntax  */
+/*  error is simply not compiled; the caller then falls back   */
+/*  to Evaluate().                                             */
+/*                                                             */
+/***************************************************************/
+
+/* Instruction opcodes */
+#define CX_CONST   0   /* Push constant number arg */
+#define CX_LOCAL   1   /* Push the local variable in slot arg */
+#define CX_VAR     2   /* Push the global variable named by name arg */
+#define CX_SYSVAR  3   /* Push the system variable named by name arg */
+#define CX_UNOP    4   /* Apply unary operator UnOp[arg] */
+#define CX_BINOP   5   /* Apply binary operator BinOp[arg] */
+#define CX_FUNC    6   /* Call built-in function Func[arg] */
+#define CX_UFUNC   7   /* Call the user function named by name arg */
+
+typedef struct {
+    unsigned char opcode;
+    unsigned char pending;  /* Operators Evaluate() would have stacked */
+    short nargs;            /* Number of arguments for function calls */
+    int arg;
+    int pos;                /* Where Evaluate() would be in the input */
+} ExprInstr;
+
+struct cexpr_struct {
+    ExprInstr *code;
+    int ncode;
+    Value *consts;
+    int nconsts;
+    char **names;
+    int nnames;
+    int len;         /* Length of input consumed */
+    char term;       /* Token that ended the expression, or 0 */
+    int maxops;      /* Deepest operator stack Evaluate() would use */
+    char timesep;    /* Separators in effect when compiled */
+    char datesep;
+};
+
+/* State of the compiler */
+typedef struct {
+    CompiledExpr *c;
+    char const *start;
+    Var *locals;
+    DynamicBuffer tok;
+    int nops;        /* Operators Evaluate() would have stacked */
+    Operator const *ops[OP_STACK_SIZE];
+    int maxcode, maxconsts, maxnames;
+} ExprCompiler;
+
+static int CompileSub (ExprCompiler *x, char const **s);
+static int Emit (ExprCompiler *x, int opcode, int arg, int nargs, char const *s);
+static int EmitOperator (ExprCompiler *x, Operator const *o, char const *s);
+static int AddName (ExprCompiler *x, char const *name);
+static int RunCompiledExpr (CompiledExpr *c, char const **s, Var *locals, ParsePtr p);
+
+/***************************************************************/
+/*                                                             */
+/*  CompileExpr                                                */
+/*                                                             */
+/*  Compile the expression starting at s, just as Evaluate()   */
+/*  would parse it with the given local variables.  The        */
+/*  locals must be an array linked in order, as user-defined   */
+/*  functions keep them, since compiled code finds a local by  */
+/*  its index.  Returns NULL if it can't be compiled.          */
+/*                                                             */
+/***************************************************************/
+CompiledExpr *CompileExpr(char const *s, Var *locals)
+{
+    ExprCompiler x;
+    char const *t = s;
+    int r;
+
+    x.c = NEW(CompiledExpr);
+    if (!x.c) return NULL;
+    memset(x.c, 0, sizeof(CompiledExpr));
+    x.start = s;
+    x.locals = locals;
+    x.nops = 0;
+    x.maxcode = x.maxconsts = x.maxnames = 0;
+    DBufInit(&x.tok);
+
+    r = CompileSub(&x, &t);
+    if (!r) {
+	x.c->len = t - s;
+	x.c->term = *DBufValue(&x.tok);
+	x.c->timesep = TimeSep;
+	x.c->datesep = DateSep;
+    }
+    DBufFree(&x.tok);
+    if (r) {
+	FreeCompiledExpr(x.c);
+	return NULL;
+    }
+    return x.c;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeCompiledExpr                                           */
+/*                                                             */
+/***************************************************************/
+void FreeCompiledExpr(CompiledExpr *c)
+{
+    int i;
+
+    if (!c) return;
+    for (i=0; i<c->nconsts; i++) DestroyValue(c->consts[i]);
+    for (i=0; i<c->nnames; i++) free(c->names[i]);
+    free(c->code);
+    free(c->consts);
+    free(c->names);
+    free(c);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CompiledExprStale                                          */
+/*                                                             */
+/*  Return 1 if the expression was compiled with different     */
+/*  date or time separators, which change how it is tokenized. */
+/*                                                             */
+/***************************************************************/
+int CompiledExprStale(CompiledExpr const *c)
+{
+    return (c->timesep != TimeSep || c->datesep != DateSep);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CompiledExprSelfContained                                  */
+/*                                                             */
+/*  Return 1 if the value of c can depend only on the trigger  */
+/*  date, the OMIT context and today's date: it reads no       */
+/*  variables, calls no user-defined functions, and calls no   */
+/*  built-in function that looks at files, the environment,    */
+/*  variables or trigger state that depends on how the         */
+/*  trigger was searched for.                                  */
+/*                                                             */
+/***************************************************************/
+int CompiledExprSelfContained(CompiledExpr const *c)
+{
+    static char const *const outside[] = {
+	"access", "args", "defined", "filedate", "filedatetime",
+	"filedir", "filename", "getenv", "trig", "trigdatetime",
+	"trigduration", "trigeventduration", "trigeventstart",
+	"trigscanfrom", "trigtime", "trigtimedelta", "trigtimerep",
+	"value", NULL
+    };
+    char const *const *o;
+    int i;
+
+    for (i=0; i<c->ncode; i++) {
+	switch(c->code[i].opcode) {
+	case CX_VAR:
+	case CX_SYSVAR:
+	case CX_UFUNC:
+	    return 0;
+
+	case CX_FUNC:
+	    for (o = outside; *o; o++) {
+		if (!strcmp(Func[c->code[i].arg].name, *o)) return 0;
+	    }
+	    break;
+	}
+    }
+    return 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  EvaluateCompiled                                           */
+/*                                                             */
+/*  Like Evaluate(), but run c, which must have been compiled  */
+/*  from *s with the same local variables.  Falls back to      */
+/*  Evaluate() if c is NULL or can't reproduce what Evaluate() */
+/*  would do: when tracing expressions, when the separators    */
+/*  have changed, or when the operator stack would overflow.   */
+/*                                                             */
+/***************************************************************/
+int EvaluateCompiled(CompiledExpr *c, char const **s, Var *locals, ParsePtr p)
+{
+    if (!c ||
+	(DebugFlag & DB_PRTEXPR) ||
+	CompiledExprStale(c) ||
+	OpStackPtr + c->maxops > OP_STACK_SIZE) {
+	return Evaluate(s, locals, p);
+    }
+    return RunCompiledExpr(c, s, locals, p);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CompileSub                                                 */
+/*                                                             */
+/*  Compile one (sub-)expression.  This follows Evaluate()     */
+/*  step by step; see there.                                   */
+/*                                                             */
+/***************************************************************/
+static int CompileSub(ExprCompiler *x, char const **s)
+{
+    int OpBase = x->nops;
+    int r, args, i;
+    Operator *o;
+    BuiltinFunc *f;
+    Var *v;
+    Value va;
+    char *tok;
+    int name = 0;
+
+    while(1) {
+	r = ReadExprToken(&x->tok, s);
+	if (r) return r;
+	if (!DBufLen(&x->tok)) return E_EOLN;
+	tok = DBufValue(&x->tok);
+
+	if (*tok == '(') {
+	    r = CompileSub(x, s);
+	    if (r) return r;
+	    if (*DBufValue(&x->tok) != ')') return E_MISS_RIGHT_PAREN;
+	} else if (*tok == '+') {
+	    continue;
+	} else if (tok[DBufLen(&x->tok)-1] == '(') { /* Function call */
+	    tok[DBufLen(&x->tok)-1] = 0;
+	    f = FindFunc(tok, Func, NumFuncs);
+	    if (!f) {
+		name = AddName(x, tok);
+		if (name < 0) return E_NO_MEM;
+	    }
+	    DBufFree(&x->tok);
+	    args = 0;
+	    if (PeekChar(s) != ')') {
+		while(1) {
+		    args++;
+		    r = CompileSub(x, s);
+		    if (r) return r;
+		    if (*DBufValue(&x->tok) == ')') break;
+		    if (*DBufValue(&x->tok) != ',') return E_EXPECT_COMMA;
+		}
+	    }
+	    if (f) {
+		r = Emit(x, CX_FUNC, f - Func, args, *s);
+	    } else {
+		r = Emit(x, CX_UFUNC, name, args, *s);
+	    }
+	    if (r) return r;
+	    if (!args) {
+		r = ReadExprToken(&x->tok, s);
+		if (r) return r;
+	    }
+	} else {
+	    o = FindOperator(tok, UnOp, NUM_UN_OPS);
+	    if (o) {
+		if (x->nops >= OP_STACK_SIZE) return E_OP_STK_OVER;
+		x->ops[x->nops++] = o;
+		if (x->nops > x->c->maxops) x->c->maxops = x->nops;
+		continue;
+	    }
+	    if (*tok == '$') {
+		name = AddName(x, tok);
+		if (name < 0) return E_NO_MEM;
+		r = Emit(x, CX_SYSVAR, name, 0, *s);
+	    } else if (*tok == '"' || *tok == '\'' || isdigit(*tok)) {
+		r = MakeValue(tok, &va, NULL, NULL);
+		if (r) return r;
+		if (x->c->nconsts >= x->maxconsts) {
+		    Value *nv;
+		    x->maxconsts = x->maxconsts ? 2 * x->maxconsts : 8;
+		    nv = realloc(x->c->consts, x->maxconsts * sizeof(Value));
+		    if (!nv) {
+			DestroyValue(va);
+			return E_NO_MEM;
+		    }
+		    x->c->consts = nv;
+		}
+		x->c->consts[x->c->nconsts++] = va;
+		r = Emit(x, CX_CONST, x->c->nconsts-1, 0, *s);
+	    } else if (ISID(*tok)) {
+		for (i=0, v=x->locals; v; i++, v=v->next) {
+		    if (!StrinCmp(tok, v->name, VAR_NAME_LEN)) break;
+		}
+		if (v) {
+		    r = Emit(x, CX_LOCAL, i, 0, *s);
+		} else {
+		    name = AddName(x, tok);
+		    if (name < 0) return E_NO_MEM;
+		    r = Emit(x, CX_VAR, name, 0, *s);
+		}
+	    } else {
+		return E_ILLEGAL_CHAR;
+	    }
+	    if (r) return r;
+	}
+
+	/* Now looking for the end of the expression or a binary operator */
+	r = ReadExprToken(&x->tok, s);
+	if (r) return r;
+	tok = DBufValue(&x->tok);
+	if (*tok == 0 || *tok == ',' || *tok == ']' || *tok == ')') {
+	    while (x->nops > OpBase) {
+		r = EmitOperator(x, x->ops[--x->nops], *s);
+		if (r) return r;
+	    }
+	    return OK;
+	}
+	o = FindOperator(tok, BinOp, NUM_BIN_OPS);
+	if (!o) return E_EXPECTING_BINOP;
+	while (x->nops > OpBase && x->ops[x->nops-1]->prec >= o->prec) {
+	    r = EmitOperator(x, x->ops[--x->nops], *s);
+	    if (r) return r;
+	}
+	if (x->nops >= OP_STACK_SIZE) return E_OP_STK_OVER;
+	x->ops[x->nops++] = o;
+	if (x->nops > x->c->maxops) x->c->maxops = x->nops;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  Emit                                                       */
+/*                                                             */
+/*  Append an instruction; s is where Evaluate() would be in   */
+/*  the input when carrying it out.                            */
+/*                                                             */
+/***************************************************************/
+static int Emit(ExprCompiler *x, int opcode, int arg, int nargs, char const *s)
+{
+    ExprInstr *i;
+
+    if (x->c->ncode >= x->maxcode) {
+	x->maxcode = x->maxcode ? 2 * x->maxcode : 16;
+	i = realloc(x->c->code, x->maxcode * sizeof(ExprInstr));
+	if (!i) return E_NO_MEM;
+	x->c->code = i;
+    }
+    i = &x->c->code[x->c->ncode++];
+    i->opcode = opcode;
+    i->pending = x->nops;
+    i->nargs = nargs;
+    i->arg = arg;
+    i->pos = s - x->start;
+    return OK;
+}
+
+static int EmitOperator(ExprCompiler *x, Operator const *o, char const *s)
+{
+    if (o->type == UN_OP) {
+	return Emit(x, CX_UNOP, o - UnOp, 0, s);
+    }
+    return Emit(x, CX_BINOP, o - BinOp, 0, s);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddName                                                    */
+/*                                                             */
+/*  Add a name to the compiled expression; return its index or */
+/*  -1 if we run out of memory.                                */
+/*                                                             */
+/***************************************************************/
+static int AddName(ExprCompiler *x, char const *name)
+{
+    char *n = StrDup(name);
+
+    if (!n) return -1;
+    if (x->c->nnames >= x->maxnames) {
+	char **nn;
+	x->maxnames = x->maxnames ? 2 * x->maxnames : 8;
+	nn = realloc(x->c->names, x->maxnames * sizeof(char *));
+	if (!nn) {
+	    free(n);
+	    return -1;
+	}
+	x->c->names = nn;
+    }
+    x->c->names[x->c->nnames] = n;
+    return x->c->nnames++;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunCompiledExpr                                            */
+/*                                                             */
+/*  Run a compiled expression, leaving its value on the value  */
+/*  stack.  On return, *s and ExprBuf are left just as         */
+/*  Evaluate() would have left them.                           */
+/*                                                             */
+/***************************************************************/
+static int RunCompiledExpr(CompiledExpr *c, char const **s, Var *locals, ParsePtr p)
+{
+    int OpBase = OpStackPtr;
+    ExprInstr *i, *end = c->code + c->ncode;
+    Operator *o;
+    BuiltinFunc *f;
+    Value va;
+    int r = OK;
+
+    for (i = c->code; i < end; i++) {
+	switch(i->opcode) {
+	case CX_CONST:
+	    r = CopyValue(&va, &c->consts[i->arg]);
+	    if (r) break;
+	    if (ValStackPtr >= VAL_STACK_SIZE) {
+		DestroyValue(va);
+		r = E_VA_STK_OVER;
+		break;
+	    }
+	    ValStack[ValStackPtr++] = va;
+	    continue;
+
+	case CX_LOCAL:
+	    r = CopyValue(&va, &locals[i->arg].v);
+	    if (r) break;
+	    if (ValStackPtr >= VAL_STACK_SIZE) {
+		DestroyValue(va);
+		r = E_VA_STK_OVER;
+		break;
+	    }
+	    ValStack[ValStackPtr++] = va;
+	    continue;
+
+	case CX_VAR:
+	case CX_SYSVAR:
+	    if (i->opcode == CX_VAR) {
+		r = GetVarValue(c->names[i->arg], &va, NULL, p);
+	    } else {
+		if (p) p->nonconst_expr = 1;
+		r = GetSysVar(c->names[i->arg]+1, &va);
+	    }
+	    if (r) break;
+	    if (ValStackPtr >= VAL_STACK_SIZE) {
+		DestroyValue(va);
+		r = E_VA_STK_OVER;
+		break;
+	    }
+	    ValStack[ValStackPtr++] = va;
+	    continue;
+
+	case CX_UNOP:
+	case CX_BINOP:
+	    o = (i->opcode == CX_UNOP) ? &UnOp[i->arg] : &BinOp[i->arg];
+	    r = (o->func)();
+	    if (r) {
+		Eprint("`%s': %s", o->name, ErrMsg[r]);
+		break;
+	    }
+	    continue;
+
+	case CX_FUNC:
+	case CX_UFUNC:
+	    /* Evaluate() has its pending operators stacked during the
+	       call, and nothing in ExprBuf for a call without arguments;
+	       the function may itself evaluate expressions */
+	    OpStackPtr = OpBase + i->pending;
+	    if (!i->nargs) DBufFree(&ExprBuf);
+	    if (i->opcode == CX_FUNC) {
+		f = &Func[i->arg];
+		if (!f->is_constant && (p != NULL)) p->nonconst_expr = 1;
+		r = CallFunc(f, i->nargs);
+	    } else {
+		r = CallUserFunc(c->names[i->arg], i->nargs, p);
+	    }
+	    OpStackPtr = OpBase;
+	    if (r) {
+		*s += i->pos;
+		if (i->nargs) DBufFree(&ExprBuf);
+		return r;
+	    }
+	    continue;
+	}
+
+	/* Something went wrong */
+	*s += i->pos;
+	DBufFree(&ExprBuf);
+	return r;
+    }
+
+    /* Leave the input and the last token just as Evaluate() does */
+    *s += c->len;
+    DBufFree(&ExprBuf);
+    if (c->term) DBufPutc(&ExprBuf, c->term);
+    return OK;
+}
@@ -11,6 +11,7 @@
 /*                                                             */
 /***************************************************************/
 
+#include "version.h"
 #include "config.h"
 
 #include <stdio.h>
@@ -18,6 +19,7 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 #ifdef TM_IN_SYS_TIME
@@ -34,10 +36,20 @@
 #include <glob.h>
 #endif
 
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT1)
+#include <sys/inotify.h>
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define USE_MMAP 1
+#endif
+
 #include "types.h"
 #include "protos.h"
 #include "globals.h"
 #include "err.h"
+#include "md5.h"
 
 
 /* Convenient macros for closing files */
@@ -45,19 +57,76 @@
 #define PCLOSE(fp) (((fp)&&((fp)!=stdin)) ? (pclose(fp),(fp)=NULL) : ((fp)=NULL))
 
 /* Define the structures needed by the file caching system */
+
+/* A compiled expression found at a given offset in a cached line */
+typedef struct expr_cache {
+    struct expr_cache *next;
+    int offset;
+    CompiledExpr *code;
+} ExprCache;
+
 typedef struct cache {
     struct cache *next;
     char const *text;
     int LineNo;
+    int len;
+    ExprCache *exprs;
+    CalMemo *memo;
 } CachedLine;
 
+/* A name by which a cached file is known.  The same file reached
+   through a symlink or a different relative path has several. */
+typedef struct file_name {
+    struct file_name *next;     /* Next in hash bucket */
+    struct file_name *cnext;    /* Next name of the same file */
+    char const *name;
+    struct cheader *cf;
+} CachedFileName;
+
 typedef struct cheader {
     struct cheader *next;
+    struct cheader *prev;
+    struct cheader *inext;      /* Next in inode hash bucket */
     char const *filename;
+    CachedFileName names;       /* filename, followed by any aliases */
     CachedLine *cache;
     int ownedByMe;
+    int fromCmd;        /* Output of INCLUDECMD */
+    int haveStat;       /* Is statbuf valid? */
+    struct stat statbuf;
+    CachedLine *lines;  /* If non-NULL, all lines in one block... */
+    char *map;          /* ... with text in this arena or cache image */
+    size_t maplen;
+    int mapped;         /* Was map obtained with mmap()? */
 } CachedFile;
 
+/* The on-disk cache written with --cache holds, for each reminder
+   file, this header, the file's full path padded to a multiple of
+   8 bytes, nlines DiskCacheLine records, and then the text of the
+   lines, each terminated by a NUL. */
+#define DISK_CACHE_MAGIC "REMCACH1"
+typedef struct {
+    char magic[8];
+    char version[16];   /* Remind version that wrote the cache */
+    unsigned int hdrsize;
+    unsigned int pathspace;
+    unsigned int nlines;
+    unsigned int textlen;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    time_t ctime;
+    time_t written;     /* When the cache was written */
+    unsigned char md5[16];
+} DiskCacheHeader;
+
+typedef struct {
+    int LineNo;
+    int len;
+    unsigned int offset;
+} DiskCacheLine;
+
 /* A linked list of filenames if we INCLUDE /some/directory/  */
 typedef struct fname_chain {
     struct fname_chain *next;
@@ -67,8 +136,11 @@ typedef struct fname_chain {
 /* Cache filename chains for directories */
 typedef struct directory_fname_chain {
     struct directory_fname_chain *next;
+    struct directory_fname_chain *hnext;
     FilenameChain *chain;
     char const *dirname;
+    int haveStat;                 /* Whether statbuf is valid */
+    struct stat statbuf;          /* The directory when it was listed */
 } DirectoryFilenameChain;
 
 /* Define the structures needed by the INCLUDE file system */
@@ -85,8 +157,16 @@ typedef struct {
 
 static CachedFile *CachedFiles = (CachedFile *) NULL;
 static CachedLine *CLine = (CachedLine *) NULL;
+static CachedLine *CurCLine = (CachedLine *) NULL;  /* Line being processed */
 static DirectoryFilenameChain *CachedDirectoryChains = NULL;
 
+/* Hash indexes of the cached files by name and by device and inode,
+   and of the cached directory listings by name */
+#define FILE_HASH_SIZE 1024
+static CachedFileName *FileNameHash[FILE_HASH_SIZE];
+static CachedFile *FileInodeHash[FILE_HASH_SIZE];
+static DirectoryFilenameChain *DirectoryHash[FILE_HASH_SIZE];
+
 static FILE *fp;
 
 static IncludeStruct IStack[INCLUDE_NEST];
@@ -95,7 +175,22 @@ static int IStackPtr = 0;
 static int ReadLineFromFile (int use_pclose);
 static int CacheFile (char const *fname, int use_pclose);
 static void DestroyCache (CachedFile *cf);
+static int SplitFileLines (CachedFile *cf);
+static unsigned int FileHash (char const *name);
+static unsigned int InodeHash (struct stat const *sb);
+static CachedFile *FindCachedFile (char const *fname);
+static CachedFile *FindCachedInode (struct stat const *sb);
+static void AddCachedName (CachedFile *cf, char const *name);
+static void LinkCachedFile (CachedFile *cf);
+static void UnlinkCachedFile (CachedFile *cf);
+static void RemoveCachedName (CachedFileName *n);
+static void DropCachedAliases (CachedFile *cf);
+static int SameStat (struct stat const *a, struct stat const *b);
+static void RehashDirectories (void);
+static int LoadDiskCache (char const *fname);
+static void WriteDiskCache (CachedFile *cf);
 static int CheckSafety (void);
+static int TrustedOwner (uid_t uid);
 static int PopFile (void);
 static int IncludeCmd(char const *);
 static void OpenPurgeFile(char const *fname, char const *mode)
@@ -161,6 +256,7 @@ int ReadLine(void)
     if (CLine) {
 	CurLine = CLine->text;
 	LineNo = CLine->LineNo;
+	CurCLine = CLine;
 	CLine = CLine->next;
 	FreshLine = 1;
         clear_callstack();
@@ -169,6 +265,7 @@ int ReadLine(void)
     }
 
 /* Not cached.  Read from the file. */
+    CurCLine = NULL;
     return ReadLineFromFile(0);
 }
 
@@ -283,8 +380,9 @@ static int ReadLineFromFile(int use_pclose)
 /***************************************************************/
 int OpenFile(char const *fname)
 {
-    CachedFile *h = CachedFiles;
-    int r;
+    CachedFile *h;
+    struct stat sb;
+    int r, diskcache;
 
     if (PurgeMode) {
 	if (PurgeFP != NULL && PurgeFP != stdout) {
@@ -295,22 +393,20 @@ int OpenFile(char const *fname)
 
 /* If it's in the cache, get it from there. */
 
-    while (h) {
-	if (!strcmp(fname, h->filename)) {
-	    if (DebugFlag & DB_TRACE_FILES) {
-		fprintf(ErrFp, "Reading `%s': Found in cache\n", fname);
-	    }
-	    CLine = h->cache;
-	    STRSET(FileName, fname);
-	    LineNo = 0;
-	    if (!h->ownedByMe) {
-		RunDisabled |= RUN_NOTOWNER;
-	    } else {
-		RunDisabled &= ~RUN_NOTOWNER;
-            }
-	    if (FileName) return OK; else return E_NO_MEM;
+    h = FindCachedFile(fname);
+    if (h) {
+	if (DebugFlag & DB_TRACE_FILES) {
+	    fprintf(ErrFp, "Reading `%s': Found in cache\n", fname);
+	}
+	CLine = h->cache;
+	STRSET(FileName, fname);
+	LineNo = 0;
+	if (!h->ownedByMe) {
+	    RunDisabled |= RUN_NOTOWNER;
+	} else {
+	    RunDisabled &= ~RUN_NOTOWNER;
 	}
-	h = h->next;
+	if (FileName) return OK; else return E_NO_MEM;
     }
 
 /* If it's a dash, then it's stdin */
@@ -334,12 +430,33 @@ int OpenFile(char const *fname)
     }
     if (!fp || !CheckSafety()) return E_CANT_OPEN;
     CLine = NULL;
-    if (ShouldCache) {
+
+/* It may be a file we've cached under another name */
+    if (fp != stdin && !PurgeMode && !fstat(fileno(fp), &sb) &&
+	(h = FindCachedInode(&sb)) != NULL) {
+	if (DebugFlag & DB_TRACE_FILES) {
+	    fprintf(ErrFp, "Reading `%s': Found in cache as `%s'\n",
+		    fname, h->filename);
+	}
+	FCLOSE(fp);
+	AddCachedName(h, fname);
+	CLine = h->cache;
+	STRSET(FileName, fname);
+	LineNo = 0;
+	if (FileName) return OK; else return E_NO_MEM;
+    }
+
+    diskcache = (UseDiskCache && !PurgeMode && fp != stdin);
+    if (diskcache && LoadDiskCache(fname) == OK) {
+	FCLOSE(fp);
+	CLine = CachedFiles->cache;
+    } else if (ShouldCache || diskcache) {
 	LineNo = 0;
 	r = CacheFile(fname, 0);
 	if (r == OK) {
 	    fp = NULL;
 	    CLine = CachedFiles->cache;
+	    if (diskcache) WriteDiskCache(CachedFiles);
 	} else {
 	    if (strcmp(fname, "-")) {
 		fp = fopen(fname, "r");
@@ -386,7 +503,12 @@ static int CacheFile(char const *fname, int use_pclose)
         }
 	return E_NO_MEM;
     }
+    cf->prev = NULL;
     cf->cache = NULL;
+    cf->lines = NULL;
+    cf->map = NULL;
+    cf->maplen = 0;
+    cf->mapped = 0;
     cf->filename = StrDup(fname);
     if (!cf->filename) {
 	ShouldCache = 0;
@@ -405,6 +527,32 @@ static int CacheFile(char const *fname, int use_pclose)
 	cf->ownedByMe = 1;
     }
 
+/* Remember what the file looked like so we can tell if it changes */
+    cf->fromCmd = use_pclose;
+    cf->haveStat = 0;
+    if (!use_pclose && fp != stdin && !fstat(fileno(fp), &cf->statbuf)) {
+	cf->haveStat = 1;
+    }
+
+/* Read a regular file in one go if we can.  Not when echoing lines,
+   though, since the echo is done as each line is read. */
+    if (cf->haveStat && S_ISREG(cf->statbuf.st_mode) && !PurgeMode &&
+	!(DebugFlag & DB_ECHO_LINE)) {
+	r = SplitFileLines(cf);
+	if (r == OK) {
+	    FCLOSE(fp);
+	    LinkCachedFile(cf);
+	    return OK;
+	}
+	if (r != E_CANT_OPEN) {
+	    DestroyCache(cf);
+	    ShouldCache = 0;
+	    FCLOSE(fp);
+	    return r;
+	}
+	rewind(fp);
+    }
+
 /* Read the file */
     while(fp) {
 	r = ReadLineFromFile(use_pclose);
@@ -454,6 +602,9 @@ static int CacheFile(char const *fname, int use_pclose)
 	    }
 	    cl->next = NULL;
 	    cl->LineNo = LineNo;
+	    cl->exprs = NULL;
+	    cl->memo = NULL;
+	    cl->len = strlen(s);
 	    cl->text = StrDup(s);
 	    DBufFree(&LineBuffer);
 	    if (!cl->text) {
@@ -470,12 +621,443 @@ static int CacheFile(char const *fname, int use_pclose)
     }
 
 /* Put the cached file at the head of the queue */
-    cf->next = CachedFiles;
-    CachedFiles = cf;
+    LinkCachedFile(cf);
 
     return OK;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  SplitFileLines                                             */
+/*                                                             */
+/*  Cache the regular file open as fp in a single pass.  The   */
+/*  file is mapped (or read whole) and each line worth keeping */
+/*  is copied, with its continuation lines joined, into one    */
+/*  arena.  One array of CachedLines points into the arena, so */
+/*  the whole file takes a fixed number of allocations.        */
+/*  Returns E_CANT_OPEN if the file can't be mapped or read,   */
+/*  in which case the caller should read it with stdio.        */
+/*                                                             */
+/***************************************************************/
+static int SplitFileLines(CachedFile *cf)
+{
+    size_t size, n, maxlines, nlines;
+    char const *src, *end, *p, *nl;
+    char *arena, *dst, *start, *s;
+    CachedLine *lines;
+    ssize_t got;
+    int fd = fileno(fp);
+    int lineno = 0;
+#ifdef USE_MMAP
+    void *map = NULL;
+#endif
+
+    size = (size_t) cf->statbuf.st_size;
+    if ((off_t) size != cf->statbuf.st_size || size == (size_t) -1) {
+	return E_CANT_OPEN;
+    }
+    arena = malloc(size + 1);
+    if (!arena) return E_NO_MEM;
+
+/* Map the file; failing that, read it into the arena and split it
+   in place.  Joined lines are never longer than their source, so
+   the copy never overtakes the text still to be read. */
+    src = NULL;
+#ifdef USE_MMAP
+    if (size) {
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+	    map = NULL;
+	} else {
+	    src = map;
+	}
+    }
+#endif
+    if (!src) {
+	if (lseek(fd, 0, SEEK_SET) < 0) {
+	    free(arena);
+	    return E_CANT_OPEN;
+	}
+	for (n = 0; n < size; n += got) {
+	    got = read(fd, arena + n, size - n);
+	    if (got < 0) {
+		free(arena);
+		return E_CANT_OPEN;
+	    }
+	    if (!got) break;
+	}
+	size = n;
+	src = arena;
+    }
+    end = src + size;
+
+/* There can't be more lines than newlines, plus one */
+    maxlines = 1;
+    for (p = src; (p = memchr(p, '\n', end - p)) != NULL; p++) maxlines++;
+    lines = malloc(maxlines * sizeof(CachedLine));
+    if (!lines) {
+#ifdef USE_MMAP
+	if (map) munmap(map, size);
+#endif
+	free(arena);
+	return E_NO_MEM;
+    }
+
+    nlines = 0;
+    dst = arena;
+    p = src;
+    while (p < end) {
+	/* Gather a line and its continuations */
+	start = dst;
+	while (1) {
+	    nl = memchr(p, '\n', end - p);
+	    n = (nl ? nl : end) - p;
+	    memmove(dst, p, n);
+	    dst += n;
+	    p = nl ? nl + 1 : end;
+	    lineno++;
+	    if (!n || dst[-1] != '\\') break;
+	    dst[-1] = '\n';
+	    if (p == end) {
+		/* stdio reads one more, empty, line before seeing EOF */
+		if (nl) lineno++;
+		break;
+	    }
+	}
+	*dst = 0;
+
+	/* __EOF__ ends the file */
+	if (!strcmp(start, "__EOF__")) {
+	    dst = start;
+	    break;
+	}
+
+	/* Keep it unless it's blank or a comment */
+	s = start;
+	while (isempty(*s)) s++;
+	if (*s && *s != ';' && *s != '#') {
+	    lines[nlines].text = s;
+	    lines[nlines].LineNo = lineno;
+	    lines[nlines].len = strlen(s);
+	    lines[nlines].exprs = NULL;
+	    lines[nlines].memo = NULL;
+	    lines[nlines].next = NULL;
+	    if (nlines) lines[nlines-1].next = &lines[nlines];
+	    nlines++;
+	    dst++;
+	} else {
+	    dst = start;
+	}
+    }
+#ifdef USE_MMAP
+    if (map) munmap(map, size);
+#endif
+
+    if (!nlines) {
+	free(lines);
+	free(arena);
+	return OK;
+    }
+    cf->cache = lines;
+    cf->lines = lines;
+    cf->map = arena;
+    cf->maplen = size + 1;
+    cf->mapped = 0;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SameStat                                                   */
+/*                                                             */
+/*  Return 1 if two stat results look like the same, unchanged */
+/*  file.                                                      */
+/*                                                             */
+/***************************************************************/
+static int SameStat(struct stat const *a, struct stat const *b)
+{
+    return (a->st_dev   == b->st_dev &&
+	    a->st_ino   == b->st_ino &&
+	    a->st_size  == b->st_size &&
+	    a->st_mtime == b->st_mtime &&
+	    a->st_ctime == b->st_ctime);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  The on-disk file cache                                     */
+/*                                                             */
+/*  With --cache, the lines CacheFile() extracts from each     */
+/*  reminder file are saved under the per-user cache           */
+/*  directory.  A later run whose file still has the same      */
+/*  device, inode, size, mtime and ctime maps the saved image  */
+/*  and uses it directly instead of re-reading the file.  If   */
+/*  the file was modified in the same second the cache was     */
+/*  written, its timestamps prove nothing, so its contents are */
+/*  compared against the MD5 sum stored in the cache.          */
+/*                                                             */
+/***************************************************************/
+static int DiskCacheName(char const *fname, DynamicBuffer *path,
+			 DynamicBuffer *cname)
+{
+    char *rp;
+    struct MD5Context ctx;
+    unsigned char sum[16];
+    char hex[34];
+    int i;
+
+    rp = realpath(fname, NULL);
+    if (!rp) return E_CANT_OPEN;
+    if (DBufPuts(path, rp) != OK) {
+	free(rp);
+	return E_NO_MEM;
+    }
+    free(rp);
+    if (GetCacheDir("files", cname) != OK) return E_CANT_OPEN;
+
+    MD5Init(&ctx);
+    MD5Update(&ctx, (unsigned char *) DBufValue(path), DBufLen(path));
+    MD5Final(sum, &ctx);
+    hex[0] = '/';
+    for (i=0; i<16; i++) {
+	sprintf(hex + 1 + 2*i, "%02x", (unsigned int) sum[i]);
+    }
+    return DBufPuts(cname, hex);
+}
+
+static int FileMD5(int fd, unsigned char *sum)
+{
+    struct MD5Context ctx;
+    unsigned char buf[8192];
+    ssize_t n;
+
+    if (lseek(fd, 0, SEEK_SET) < 0) return E_IO_ERR;
+    MD5Init(&ctx);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+	MD5Update(&ctx, buf, (unsigned) n);
+    }
+    MD5Final(sum, &ctx);
+    return (n < 0) ? E_IO_ERR : OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  LoadDiskCache                                              */
+/*                                                             */
+/*  Try to cache fname (already open as fp) from the on-disk   */
+/*  cache.  On success, the file is at the head of             */
+/*  CachedFiles.  On failure, fp is left at the start of the   */
+/*  file.                                                      */
+/*                                                             */
+/***************************************************************/
+static int LoadDiskCache(char const *fname)
+{
+    DynamicBuffer path, cname;
+    struct stat sb, csb;
+    DiskCacheHeader hdr;
+    DiskCacheLine const *dl;
+    CachedFile *cf;
+    CachedLine *lines = NULL;
+    char *map = NULL;
+    char const *text;
+    size_t maplen = 0, linesoff, textoff, n;
+    ssize_t got;
+    int mapped = 0;
+    int fd = -1;
+    int r = E_CANT_OPEN;
+    unsigned int i;
+    unsigned char sum[16];
+
+    if (fstat(fileno(fp), &sb) || !S_ISREG(sb.st_mode)) return E_CANT_OPEN;
+
+    DBufInit(&path);
+    DBufInit(&cname);
+    if (DiskCacheName(fname, &path, &cname) != OK) goto done;
+    fd = open(DBufValue(&cname), O_RDONLY);
+    if (fd < 0) goto done;
+    if (fstat(fd, &csb) || csb.st_size < (off_t) sizeof(hdr)) goto done;
+    maplen = (size_t) csb.st_size;
+
+#ifdef USE_MMAP
+    map = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+	map = NULL;
+    } else {
+	mapped = 1;
+    }
+#endif
+    if (!map) {
+	map = malloc(maplen);
+	if (!map) goto done;
+	for (n = 0; n < maplen; n += got) {
+	    got = read(fd, map + n, maplen - n);
+	    if (got <= 0) goto done;
+	}
+    }
+
+    /* Make sure the cache is sane and belongs to this file */
+    memcpy(&hdr, map, sizeof(hdr));
+    if (memcmp(hdr.magic, DISK_CACHE_MAGIC, sizeof(hdr.magic)) ||
+	strncmp(hdr.version, VERSION, sizeof(hdr.version)) ||
+	hdr.hdrsize != sizeof(hdr) ||
+	hdr.pathspace % 8 ||
+	hdr.pathspace <= DBufLen(&path) ||
+	hdr.nlines > maplen / sizeof(DiskCacheLine)) goto done;
+    linesoff = sizeof(hdr) + hdr.pathspace;
+    textoff = linesoff + hdr.nlines * sizeof(DiskCacheLine);
+    if (textoff > maplen || maplen - textoff != hdr.textlen) goto done;
+    if (strcmp(map + sizeof(hdr), DBufValue(&path))) goto done;
+    if (hdr.dev != sb.st_dev || hdr.ino != sb.st_ino ||
+	hdr.size != sb.st_size || hdr.mtime != sb.st_mtime ||
+	hdr.ctime != sb.st_ctime) goto done;
+    if (sb.st_mtime >= hdr.written) {
+	i = (FileMD5(fileno(fp), sum) != OK || memcmp(sum, hdr.md5, 16));
+	rewind(fp);
+	if (i) goto done;
+    }
+
+    lines = malloc(hdr.nlines ? hdr.nlines * sizeof(CachedLine) : 1);
+    if (!lines) goto done;
+    dl = (DiskCacheLine const *) (map + linesoff);
+    text = map + textoff;
+    for (i=0; i<hdr.nlines; i++) {
+	if (dl[i].len < 0 || dl[i].offset >= hdr.textlen ||
+	    (size_t) dl[i].len >= hdr.textlen - dl[i].offset ||
+	    text[dl[i].offset + dl[i].len]) goto done;
+	lines[i].next = (i+1 < hdr.nlines) ? &lines[i+1] : NULL;
+	lines[i].text = text + dl[i].offset;
+	lines[i].LineNo = dl[i].LineNo;
+	lines[i].len = dl[i].len;
+	lines[i].exprs = NULL;
+	lines[i].memo = NULL;
+    }
+
+    cf = NEW(CachedFile);
+    if (!cf) goto done;
+    cf->filename = StrDup(fname);
+    if (!cf->filename) {
+	free(cf);
+	goto done;
+    }
+    cf->cache = hdr.nlines ? lines : NULL;
+    cf->lines = lines;
+    cf->map = map;
+    cf->maplen = maplen;
+    cf->mapped = mapped;
+    cf->ownedByMe = (RunDisabled & RUN_NOTOWNER) ? 0 : 1;
+    cf->fromCmd = 0;
+    cf->haveStat = 1;
+    cf->statbuf = sb;
+    LinkCachedFile(cf);
+    lines = NULL;
+    map = NULL;
+    r = OK;
+    if (DebugFlag & DB_TRACE_FILES) {
+	fprintf(ErrFp, "Reading `%s': Found in disk cache\n", fname);
+    }
+
+  done:
+    if (fd >= 0) close(fd);
+    if (lines) free(lines);
+    if (map) {
+#ifdef USE_MMAP
+	if (mapped) munmap(map, maplen);
+	else
+#endif
+	    free(map);
+    }
+    DBufFree(&path);
+    DBufFree(&cname);
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WriteDiskCache                                             */
+/*                                                             */
+/*  Save a freshly-cached file to the on-disk cache.  Failure  */
+/*  is not an error; the file is simply read again next time.  */
+/*                                                             */
+/***************************************************************/
+static void WriteDiskCache(CachedFile *cf)
+{
+    DynamicBuffer path, cname, tmpname;
+    DiskCacheHeader hdr;
+    DiskCacheLine dl;
+    CachedLine *cl;
+    struct stat sb;
+    FILE *out;
+    int fd, ok;
+    unsigned int pathlen;
+    static char const pad[8] = {0};
+    char suffix[32];
+
+    if (!cf->haveStat || !S_ISREG(cf->statbuf.st_mode)) return;
+
+    DBufInit(&path);
+    DBufInit(&cname);
+    DBufInit(&tmpname);
+    memset(&hdr, 0, sizeof(hdr));
+    if (DiskCacheName(cf->filename, &path, &cname) != OK) goto done;
+
+    /* Checksum the file, making sure it's what we just read */
+    fd = open(cf->filename, O_RDONLY);
+    if (fd < 0) goto done;
+    ok = (!fstat(fd, &sb) && SameStat(&sb, &cf->statbuf) &&
+	  FileMD5(fd, hdr.md5) == OK);
+    close(fd);
+    if (!ok) goto done;
+
+    memcpy(hdr.magic, DISK_CACHE_MAGIC, sizeof(hdr.magic));
+    strncpy(hdr.version, VERSION, sizeof(hdr.version));
+    hdr.hdrsize = sizeof(hdr);
+    pathlen = DBufLen(&path) + 1;
+    hdr.pathspace = (pathlen + 7) & ~7U;
+    for (cl = cf->cache; cl; cl = cl->next) {
+	hdr.nlines++;
+	hdr.textlen += cl->len + 1;
+    }
+    hdr.dev = sb.st_dev;
+    hdr.ino = sb.st_ino;
+    hdr.size = sb.st_size;
+    hdr.mtime = sb.st_mtime;
+    hdr.ctime = sb.st_ctime;
+    hdr.written = time(NULL);
+
+    /* Write to a temporary file and rename it so other runs never
+       see a partial cache */
+    sprintf(suffix, ".%ld.tmp", (long) getpid());
+    if (DBufPuts(&tmpname, DBufValue(&cname)) != OK ||
+	DBufPuts(&tmpname, suffix) != OK) goto done;
+    out = fopen(DBufValue(&tmpname), "wb");
+    if (!out) goto done;
+    ok = (fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+	  fwrite(DBufValue(&path), pathlen, 1, out) == 1 &&
+	  (hdr.pathspace == pathlen ||
+	   fwrite(pad, hdr.pathspace - pathlen, 1, out) == 1));
+    dl.offset = 0;
+    for (cl = cf->cache; ok && cl; cl = cl->next) {
+	dl.LineNo = cl->LineNo;
+	dl.len = cl->len;
+	ok = (fwrite(&dl, sizeof(dl), 1, out) == 1);
+	dl.offset += cl->len + 1;
+    }
+    for (cl = cf->cache; ok && cl; cl = cl->next) {
+	ok = (fwrite(cl->text, cl->len + 1, 1, out) == 1);
+    }
+    if (fclose(out) == EOF) ok = 0;
+    if (!ok || rename(DBufValue(&tmpname), DBufValue(&cname)) < 0) {
+	unlink(DBufValue(&tmpname));
+    } else if (DebugFlag & DB_TRACE_FILES) {
+	fprintf(ErrFp, "Saved `%s' in disk cache\n", cf->filename);
+    }
+
+  done:
+    DBufFree(&path);
+    DBufFree(&cname);
+    DBufFree(&tmpname);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  NextChainedFile - move to the next chained file in a glob  */
@@ -689,7 +1271,8 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
     size_t l;
     int r;
     glob_t glob_buf;
-    DirectoryFilenameChain *dc = CachedDirectoryChains;
+    DirectoryFilenameChain *dc;
+    unsigned int h;
 
     i->chain = NULL;
     if (!*dirname) return E_CANT_OPEN;
@@ -714,7 +1297,8 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
     }
 
     /* Check the cache */
-    while(dc) {
+    h = FileHash(dir);
+    for (dc = DirectoryHash[h]; dc; dc = dc->hnext) {
 	if (!strcmp(dc->dirname, dir)) {
 	    if (DebugFlag & DB_TRACE_FILES) {
 		fprintf(ErrFp, "Found cached directory listing for `%s'\n",
@@ -724,7 +1308,6 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 	    i->chain = dc->chain;
 	    return OK;
 	}
-	dc = dc->next;
     }
 
     if (DebugFlag & DB_TRACE_FILES) {
@@ -746,8 +1329,11 @@ static int SetupGlobChain(char const *dirname, IncludeStruct *i)
 	    }
 
 	    dc->chain = NULL;
+	    dc->haveStat = !stat(dir, &dc->statbuf);
 	    dc->next = CachedDirectoryChains;
 	    CachedDirectoryChains = dc;
+	    dc->hnext = DirectoryHash[h];
+	    DirectoryHash[h] = dc;
 	}
     }
 
@@ -859,24 +1445,21 @@ static int IncludeCmd(char const *cmd)
     IStackPtr++;
 
     /* If the file is cached, use it */
-    h = CachedFiles;
-    while(h) {
-        if (!strcmp(fname, h->filename)) {
-            if (DebugFlag & DB_TRACE_FILES) {
-                fprintf(ErrFp, "Reading command `%s': Found in cache\n", fname);
-            }
-            CLine = h->cache;
-            STRSET(FileName, fname);
-            DBufFree(&buf);
-            LineNo = 0;
-            if (!h->ownedByMe) {
-                RunDisabled |= RUN_NOTOWNER;
-            } else {
-                RunDisabled &= ~RUN_NOTOWNER;
-            }
-            if (FileName) return OK; else return E_NO_MEM;
+    h = FindCachedFile(fname);
+    if (h) {
+        if (DebugFlag & DB_TRACE_FILES) {
+            fprintf(ErrFp, "Reading command `%s': Found in cache\n", fname);
+        }
+        CLine = h->cache;
+        STRSET(FileName, fname);
+        DBufFree(&buf);
+        LineNo = 0;
+        if (!h->ownedByMe) {
+            RunDisabled |= RUN_NOTOWNER;
+        } else {
+            RunDisabled &= ~RUN_NOTOWNER;
         }
-        h = h->next;
+        if (FileName) return OK; else return E_NO_MEM;
     }
 
     if (DebugFlag & DB_TRACE_FILES) {
@@ -1044,27 +1627,538 @@ int GetAccessDate(char const *file)
 static void DestroyCache(CachedFile *cf)
 {
     CachedLine *cl, *cnext;
-    CachedFile *temp;
+    ExprCache *e;
+    UnlinkCachedFile(cf);
     if (cf->filename) free((char *) cf->filename);
     cl = cf->cache;
     while (cl) {
-	if (cl->text) free ((char *) cl->text);
+	if (cl == CurCLine) CurCLine = NULL;
+	if (!cf->lines && cl->text) free ((char *) cl->text);
+	while (cl->exprs) {
+	    e = cl->exprs;
+	    cl->exprs = e->next;
+	    FreeCompiledExpr(e->code);
+	    free(e);
+	}
+	FreeCalMemo(cl->memo);
 	cnext = cl->next;
-	free(cl);
+	if (!cf->lines) free(cl);
 	cl = cnext;
     }
-    if (CachedFiles == cf) CachedFiles = cf->next;
-    else {
-	temp = CachedFiles;
-	while(temp) {
-	    if (temp->next == cf) {
-		temp->next = cf->next;
+    if (cf->lines) free(cf->lines);
+    if (cf->map) {
+#ifdef USE_MMAP
+	if (cf->mapped) munmap(cf->map, cf->maplen);
+	else
+#endif
+	    free(cf->map);
+    }
+    free(cf);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FileHash                                                   */
+/*                                                             */
+/*  Hash a file or directory name.  Unlike HashVal(), this     */
+/*  looks at the whole name, since paths often share long      */
+/*  prefixes.                                                  */
+/*                                                             */
+/***************************************************************/
+static unsigned int FileHash(char const *name)
+{
+    unsigned int h = 5381;
+
+    while (*name) {
+	h = h * 33 + (unsigned char) *name++;
+    }
+    return h % FILE_HASH_SIZE;
+}
+
+static unsigned int InodeHash(struct stat const *sb)
+{
+    return (unsigned int) ((unsigned long) sb->st_ino * 31 +
+			   (unsigned long) sb->st_dev) % FILE_HASH_SIZE;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FindCachedFile                                             */
+/*                                                             */
+/*  Find a cached file (or INCLUDECMD output) by any of its    */
+/*  names.                                                     */
+/*                                                             */
+/***************************************************************/
+static CachedFile *FindCachedFile(char const *fname)
+{
+    CachedFileName *n;
+
+    for (n = FileNameHash[FileHash(fname)]; n; n = n->next) {
+	if (!strcmp(n->name, fname)) return n->cf;
+    }
+    return NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FindCachedInode                                            */
+/*                                                             */
+/*  Find a cached file that is the same, unchanged, file as    */
+/*  the one described by sb.                                   */
+/*                                                             */
+/***************************************************************/
+static CachedFile *FindCachedInode(struct stat const *sb)
+{
+    CachedFile *cf;
+
+    for (cf = FileInodeHash[InodeHash(sb)]; cf; cf = cf->inext) {
+	if (SameStat(&cf->statbuf, sb)) return cf;
+    }
+    return NULL;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddCachedName                                              */
+/*                                                             */
+/*  Remember another name for a cached file.  If we run out of */
+/*  memory, the name is simply looked up by inode again next   */
+/*  time.                                                      */
+/*                                                             */
+/***************************************************************/
+static void AddCachedName(CachedFile *cf, char const *name)
+{
+    CachedFileName *n = NEW(CachedFileName);
+    unsigned int h;
+
+    if (!n) return;
+    n->name = StrDup(name);
+    if (!n->name) {
+	free(n);
+	return;
+    }
+    h = FileHash(name);
+    n->cf = cf;
+    n->next = FileNameHash[h];
+    FileNameHash[h] = n;
+    n->cnext = cf->names.cnext;
+    cf->names.cnext = n;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  LinkCachedFile                                             */
+/*                                                             */
+/*  Put a newly-cached file at the head of CachedFiles and in  */
+/*  the hash indexes.                                          */
+/*                                                             */
+/***************************************************************/
+static void LinkCachedFile(CachedFile *cf)
+{
+    unsigned int h;
+
+    cf->prev = NULL;
+    cf->next = CachedFiles;
+    if (CachedFiles) CachedFiles->prev = cf;
+    CachedFiles = cf;
+
+    h = FileHash(cf->filename);
+    cf->names.name = cf->filename;
+    cf->names.cf = cf;
+    cf->names.cnext = NULL;
+    cf->names.next = FileNameHash[h];
+    FileNameHash[h] = &cf->names;
+
+    cf->inext = NULL;
+    if (cf->haveStat && !cf->fromCmd) {
+	h = InodeHash(&cf->statbuf);
+	cf->inext = FileInodeHash[h];
+	FileInodeHash[h] = cf;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  UnlinkCachedFile                                           */
+/*                                                             */
+/*  Remove a cached file and all its names from CachedFiles    */
+/*  and the hash indexes.  Does nothing if it was never        */
+/*  linked in.                                                 */
+/*                                                             */
+/***************************************************************/
+static void UnlinkCachedFile(CachedFile *cf)
+{
+    CachedFile **pc;
+
+    if (!cf->prev && CachedFiles != cf) return;
+
+    if (cf->prev) cf->prev->next = cf->next;
+    else CachedFiles = cf->next;
+    if (cf->next) cf->next->prev = cf->prev;
+    cf->prev = NULL;
+
+    DropCachedAliases(cf);
+    RemoveCachedName(&cf->names);
+
+    if (cf->haveStat && !cf->fromCmd) {
+	for (pc = &FileInodeHash[InodeHash(&cf->statbuf)]; *pc;
+	     pc = &(*pc)->inext) {
+	    if (*pc == cf) {
+		*pc = cf->inext;
 		break;
 	    }
-	    temp = temp->next;
 	}
     }
-    free(cf);
+}
+
+static void RemoveCachedName(CachedFileName *n)
+{
+    CachedFileName **pn;
+
+    for (pn = &FileNameHash[FileHash(n->name)]; *pn; pn = &(*pn)->next) {
+	if (*pn == n) {
+	    *pn = n->next;
+	    return;
+	}
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DropCachedAliases                                          */
+/*                                                             */
+/*  Forget all names of a cached file except its own.          */
+/*                                                             */
+/***************************************************************/
+static void DropCachedAliases(CachedFile *cf)
+{
+    CachedFileName *n;
+
+    while (cf->names.cnext) {
+	n = cf->names.cnext;
+	cf->names.cnext = n->cnext;
+	RemoveCachedName(n);
+	free((char *) n->name);
+	free(n);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RefreshFileCache                                           */
+/*                                                             */
+/*  Discard cached files and directory listings that have      */
+/*  changed on disk since they were read, so the next pass     */
+/*  re-reads them.  Cached INCLUDECMD output can't be checked  */
+/*  that way; it is discarded only if commands is non-zero.    */
+/*  Other names for unchanged files are forgotten too, since   */
+/*  a symlink may now point elsewhere.                         */
+/*  Must only be called between passes over the reminder file. */
+/*  Returns the number of cached files and listings discarded. */
+/*                                                             */
+/***************************************************************/
+int RefreshFileCache(int commands)
+{
+    CachedFile *cf = CachedFiles;
+    CachedFile *next;
+    DirectoryFilenameChain *dc, **prev;
+    struct stat sb;
+    int changed;
+    int discarded = 0;
+
+    while (cf) {
+	next = cf->next;
+	if (cf->fromCmd) {
+	    changed = commands;
+	} else if (cf->haveStat) {
+	    changed = (stat(cf->filename, &sb) ||
+		       !SameStat(&sb, &cf->statbuf));
+	} else {
+	    changed = 0;
+	}
+	if (changed) {
+	    if (DebugFlag & DB_TRACE_FILES) {
+		fprintf(ErrFp, "Discarding cached copy of `%s'\n",
+			cf->filename);
+	    }
+	    DestroyCache(cf);
+	    discarded++;
+	} else {
+	    DropCachedAliases(cf);
+	}
+	cf = next;
+    }
+
+    prev = &CachedDirectoryChains;
+    while ((dc = *prev) != NULL) {
+	if (!dc->haveStat || stat(dc->dirname, &sb) ||
+	    !SameStat(&sb, &dc->statbuf)) {
+	    if (DebugFlag & DB_TRACE_FILES) {
+		fprintf(ErrFp, "Discarding cached directory listing for `%s'\n",
+			dc->dirname);
+	    }
+	    *prev = dc->next;
+	    FreeChain(dc->chain);
+	    free((char *) dc->dirname);
+	    free(dc);
+	    discarded++;
+	} else {
+	    prev = &dc->next;
+	}
+    }
+    RehashDirectories();
+    return discarded;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PreloadFile                                                */
+/*                                                             */
+/*  Read a file into the cache without running it, so later    */
+/*  passes that INCLUDE it find it there.  If fname is a       */
+/*  directory, preload the *.rem files in it, as INCLUDE       */
+/*  would read them.                                           */
+/*                                                             */
+/***************************************************************/
+int PreloadFile(char const *fname)
+{
+    struct stat sb;
+    int oldRunDisabled = RunDisabled;
+    int r;
+#ifdef HAVE_GLOB
+    IncludeStruct i;
+    FilenameChain *fc;
+#endif
+
+    if (stat(fname, &sb)) return E_CANT_OPEN;
+#ifdef HAVE_GLOB
+    if (S_ISDIR(sb.st_mode)) {
+	r = SetupGlobChain(fname, &i);
+	if (r) return r;
+	for (fc = i.chain; fc; fc = fc->next) {
+	    r = PreloadFile(fc->filename);
+	    if (r) {
+		Eprint("%s: %s", ErrMsg[r], fc->filename);
+	    }
+	}
+	return OK;
+    }
+#endif
+
+    r = OpenFile(fname);
+    if (fp) FCLOSE(fp);
+    CLine = NULL;
+    RunDisabled = oldRunDisabled;
+    if (FileName) {
+	free(FileName);
+	FileName = NULL;
+    }
+    return r;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RecheckCachedFiles                                         */
+/*                                                             */
+/*  After changing to another user, forget the cached files    */
+/*  and directory listings that user can't read, and work out  */
+/*  again which of the rest may use RUN.                       */
+/*                                                             */
+/***************************************************************/
+void RecheckCachedFiles(void)
+{
+    CachedFile *cf = CachedFiles;
+    CachedFile *next;
+    DirectoryFilenameChain *dc, **prev;
+
+    while (cf) {
+	next = cf->next;
+	if (cf->haveStat) {
+	    if (access(cf->filename, R_OK)) {
+		DestroyCache(cf);
+	    } else {
+		cf->ownedByMe = TrustedOwner(cf->statbuf.st_uid);
+	    }
+	}
+	cf = next;
+    }
+
+    prev = &CachedDirectoryChains;
+    while ((dc = *prev) != NULL) {
+	if (access(dc->dirname, R_OK | X_OK)) {
+	    *prev = dc->next;
+	    FreeChain(dc->chain);
+	    free((char *) dc->dirname);
+	    free(dc);
+	} else {
+	    prev = &dc->next;
+	}
+    }
+    RehashDirectories();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RehashDirectories                                          */
+/*                                                             */
+/*  Rebuild DirectoryHash after listings have been removed     */
+/*  from CachedDirectoryChains.                                */
+/*                                                             */
+/***************************************************************/
+static void RehashDirectories(void)
+{
+    DirectoryFilenameChain *dc;
+
+    memset(DirectoryHash, 0, sizeof(DirectoryHash));
+    for (dc = CachedDirectoryChains; dc; dc = dc->next) {
+	dc->hnext = DirectoryHash[FileHash(dc->dirname)];
+	DirectoryHash[FileHash(dc->dirname)] = dc;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WatchCachedFiles                                           */
+/*                                                             */
+/*  Add an inotify watch on fd for every cached file and every */
+/*  cached directory listing.  Returns OK if everything read   */
+/*  in the last pass is being watched.  If not (for example,   */
+/*  a file could not be cached), the caller has to fall back   */
+/*  to polling.                                                */
+/*                                                             */
+/***************************************************************/
+int WatchCachedFiles(int fd)
+{
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT1)
+    CachedFile *cf;
+    DirectoryFilenameChain *dc;
+
+    if (!ShouldCache) return E_CANT_OPEN;
+
+    for (cf = CachedFiles; cf; cf = cf->next) {
+	if (!cf->haveStat) continue;
+	if (inotify_add_watch(fd, cf->filename,
+			      IN_CLOSE_WRITE | IN_ATTRIB |
+			      IN_MOVE_SELF | IN_DELETE_SELF) < 0) {
+	    return E_CANT_OPEN;
+	}
+	if (DebugFlag & DB_TRACE_FILES) {
+	    fprintf(ErrFp, "Watching `%s' for changes\n", cf->filename);
+	}
+    }
+    for (dc = CachedDirectoryChains; dc; dc = dc->next) {
+	if (inotify_add_watch(fd, dc->dirname,
+			      IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+			      IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF) < 0) {
+	    return E_CANT_OPEN;
+	}
+	if (DebugFlag & DB_TRACE_FILES) {
+	    fprintf(ErrFp, "Watching directory `%s' for changes\n",
+		    dc->dirname);
+	}
+    }
+    return OK;
+#else
+    UNUSED(fd);
+    return E_CANT_OPEN;
+#endif
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CachedExpr                                                 */
+/*                                                             */
+/*  If s points into the cached line currently being           */
+/*  processed, return the compiled form of the expression      */
+/*  there, compiling it the first time it's seen.  Otherwise,  */
+/*  or if it can't be compiled, return NULL.                   */
+/*                                                             */
+/***************************************************************/
+CompiledExpr *CachedExpr(char const *s)
+{
+    ExprCache *e;
+    int offset;
+
+    if (!CurCLine || s < CurCLine->text || s > CurCLine->text + CurCLine->len) {
+	return NULL;
+    }
+    offset = s - CurCLine->text;
+    for (e = CurCLine->exprs; e; e = e->next) {
+	if (e->offset == offset) break;
+    }
+    if (!e) {
+	e = NEW(ExprCache);
+	if (!e) return NULL;
+	e->offset = offset;
+	e->code = CompileExpr(s, NULL);
+	e->next = CurCLine->exprs;
+	CurCLine->exprs = e;
+    } else if (e->code && CompiledExprStale(e->code)) {
+	FreeCompiledExpr(e->code);
+	e->code = CompileExpr(s, NULL);
+    }
+    return e->code;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CachedLineMemo                                             */
+/*                                                             */
+/*  Return where the calendar can keep what it learns about    */
+/*  the cached line currently being processed, or NULL if the  */
+/*  line isn't cached.                                         */
+/*                                                             */
+/***************************************************************/
+CalMemo **CachedLineMemo(void)
+{
+    if (!CurCLine) return NULL;
+    return &CurCLine->memo;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  GetCacheDir                                                */
+/*                                                             */
+/*  Put the name of the per-user cache directory for sub into  */
+/*  dbuf, creating it if need be.  This is                     */
+/*  $XDG_CACHE_HOME/remind/sub, or $HOME/.cache/remind/sub if  */
+/*  XDG_CACHE_HOME is not set.                                 */
+/*                                                             */
+/***************************************************************/
+int GetCacheDir(char const *sub, DynamicBuffer *dbuf)
+{
+    char const *base = getenv("XDG_CACHE_HOME");
+    char const *parts[2];
+    int i;
+
+    parts[0] = "remind";
+    parts[1] = sub;
+
+    DBufFree(dbuf);
+    if (base && *base == '/') {
+	if (DBufPuts(dbuf, base) != OK) return E_NO_MEM;
+    } else {
+	base = getenv("HOME");
+	if (!base || *base != '/') return E_CANT_OPEN;
+	if (DBufPuts(dbuf, base) != OK ||
+	    DBufPuts(dbuf, "/.cache") != OK) {
+	    DBufFree(dbuf);
+	    return E_NO_MEM;
+	}
+    }
+    for (i=0; i<=2; i++) {
+	if (mkdir(DBufValue(dbuf), 0700) < 0 && errno != EEXIST) {
+	    DBufFree(dbuf);
+	    return E_CANT_OPEN;
+	}
+	if (i == 2) break;
+	if (DBufPutc(dbuf, '/') != OK ||
+	    DBufPuts(dbuf, parts[i]) != OK) {
+	    DBufFree(dbuf);
+	    return E_NO_MEM;
+	}
+    }
+    return OK;
 }
 
 /***************************************************************/
@@ -1128,22 +2222,30 @@ static int CheckSafety(void)
     }
 
     /* If file is not owned by me or a trusted user, disable RUN command */
-
-    /* Assume unsafe */
-    RunDisabled |= RUN_NOTOWNER;
-    if (statbuf.st_uid == geteuid()) {
-        /* Owned by me... safe */
+    if (TrustedOwner(statbuf.st_uid)) {
 	RunDisabled &= ~RUN_NOTOWNER;
     } else {
-        int i;
-        for (i=0; i<NumTrustedUsers; i++) {
-            if (statbuf.st_uid == TrustedUsers[i]) {
-                /* Owned by a trusted user... safe */
-                RunDisabled &= ~RUN_NOTOWNER;
-                break;
-            }
-        }
+	RunDisabled |= RUN_NOTOWNER;
     }
 
     return 1;
 }
+
+/***************************************************************/
+/*                                                             */
+/*  TrustedOwner                                               */
+/*                                                             */
+/*  Returns 1 if a file owned by uid may use RUN: that is, if  */
+/*  it is owned by me or by a trusted user.                    */
+/*                                                             */
+/***************************************************************/
+static int TrustedOwner(uid_t uid)
+{
+    int i;
+
+    if (uid == geteuid()) return 1;
+    for (i=0; i<NumTrustedUsers; i++) {
+	if (uid == TrustedUsers[i]) return 1;
+    }
+    return 0;
+}
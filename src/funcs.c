@@ -47,6 +47,7 @@
 #include "protos.h"
 #include "err.h"
 #include "expr.h"
+#include "md5.h"
 
 /* Defines that used to be static variables */
 #define Nargs (info->nargs)
@@ -160,6 +161,11 @@ static int FShellescape    (func_info *);
 static int CleanUpAfterFunc (func_info *);
 static int CheckArgs       (BuiltinFunc *f, int nargs);
 static int SunStuff        (int rise, double cosz, int jul);
+static char const *ShellCacheLookup (char const *cmd, int maxlen);
+static void ShellCacheStore (char const *cmd, int maxlen, char const *output);
+static int ShellCacheFileName (char const *cmd, int maxlen, DynamicBuffer *fname);
+static int ReadShellCacheFile (char const *cmd, int maxlen, DynamicBuffer *out);
+static void WriteShellCacheFile (char const *cmd, int maxlen, char const *output);
 
 /* "Overload" the struct Operator definition */
 #define NO_MAX 127
@@ -172,6 +178,16 @@ static int CacheYear, CacheMon, CacheDay;
 static int CacheHebJul = -1;
 static int CacheHebYear, CacheHebMon, CacheHebDay;
 
+/* Results of shell() commands already run, hashed on the command */
+#define SHELL_CACHE_SIZE 64
+typedef struct shellresult {
+    struct shellresult *next;
+    int maxlen;
+    char *cmd;
+    char *output;
+} ShellResult;
+static ShellResult *ShellCache[SHELL_CACHE_SIZE];
+
 /* We need access to the value stack */
 extern Value ValStack[];
 extern int ValStackPtr;
@@ -206,110 +222,110 @@ extern int ValStackPtr;
 
 /* The array holding the built-in functions. */
 BuiltinFunc Func[] = {
-/*	Name		minargs maxargs	is_constant func   */
-
-    {   "abs",          1,      1,      1,          FAbs },
-    {   "access",       2,      2,      0,          FAccess },
-    {   "adawn",        0,      1,      0,          FADawn},
-    {   "adusk",        0,      1,      0,          FADusk},
-    {   "ampm",         1,      3,      1,          FAmpm   },
-    {   "args",         1,      1,      0,          FArgs   },
-    {   "asc",          1,      1,      1,          FAsc    },
-    {   "baseyr",       0,      0,      1,          FBaseyr },
-    {   "char",         1,      NO_MAX, 1,          FChar   },
-    {   "choose",       2,      NO_MAX, 1,          FChoose },
-    {   "coerce",       2,      2,      1,          FCoerce },
-    {   "current",      0,      0,      0,          FCurrent },
-    {   "date",         3,      3,      1,          FDate   },
-    {   "datepart",     1,      1,      1,          FDatepart },
-    {   "datetime",     2,      5,      1,          FDateTime },
-    {   "dawn",         0,      1,      0,          FDawn},
-    {   "day",          1,      1,      1,          FDay    },
-    {   "daysinmon",    2,      2,      1,          FDaysinmon },
-    {   "defined",      1,      1,      0,          FDefined },
-    {   "dosubst",      1,      3,      0,          FDosubst },
-    {   "dusk",         0,      1,      0,          FDusk },
-    {   "easterdate",   1,      1,      0,          FEasterdate },
-    {   "evaltrig",     1,      2,      0,          FEvalTrig },
-    {   "filedate",     1,      1,      0,          FFiledate },
-    {   "filedatetime", 1,      1,      0,          FFiledatetime },
-    {   "filedir",      0,      0,      0,          FFiledir },
-    {   "filename",     0,      0,      0,          FFilename },
-    {   "getenv",       1,      1,      0,          FGetenv },
-    {   "hebdate",      2,      5,      0,          FHebdate },
-    {   "hebday",       1,      1,      0,          FHebday },
-    {   "hebmon",       1,      1,      0,          FHebmon },
-    {   "hebyear",      1,      1,      0,          FHebyear },
-    {   "hour",         1,      1,      1,          FHour   },
-    {   "iif",          1,      NO_MAX, 1,          FIif    },
-    {   "index",        2,      3,      1,          FIndex  },
-    {   "isany",        1,      NO_MAX, 1,          FIsAny  },
-    {   "isdst",        0,      2,      0,          FIsdst },
-    {   "isleap",       1,      1,      1,          FIsleap },
-    {   "isomitted",    1,      1,      0,          FIsomitted },
-    {   "language",     0,      0,      1,          FLanguage },
-    {   "lower",        1,      1,      1,          FLower  },
-    {   "max",          1,      NO_MAX, 1,          FMax    },
-    {   "min",          1,      NO_MAX, 1,          FMin    },
-    {   "minsfromutc",  0,      2,      0,          FMinsfromutc },
-    {   "minute",       1,      1,      1,          FMinute },
-    {   "mon",          1,      1,      1,          FMon    },
-    {   "monnum",       1,      1,      1,          FMonnum },
-    {   "moondate",     1,      3,      0,          FMoondate },
-    {   "moondatetime", 1,      3,      0,          FMoondatetime },
-    {   "moonphase",    0,      2,      0,          FMoonphase },
-    {   "moontime",     1,      3,      0,          FMoontime },
-    {   "ndawn",        0,      1,      0,          FNDawn},
-    {   "ndusk",        0,      1,      0,          FNDusk},
-    {   "nonomitted",   2,      NO_MAX, 0,          FNonomitted },
-    {   "now",          0,      0,      0,          FNow    },
-    {   "ord",          1,      1,      1,          FOrd    },
-    {   "ostype",       0,      0,      1,          FOstype },
-    {   "pad",          3,      4,      1,          FPad    },
-    {   "plural",       1,      3,      1,          FPlural },
-    {   "psmoon",       1,      4,      1,          FPsmoon},
-    {   "psshade",      1,      3,      1,          FPsshade},
-    {   "realcurrent",  0,      0,      0,          FRealCurrent},
-    {   "realnow",      0,      0,      0,          FRealnow},
-    {   "realtoday",    0,      0,      0,          FRealtoday },
-    {   "sgn",          1,      1,      1,          FSgn    },
-    {   "shell",        1,      2,      0,          FShell  },
-    {   "shellescape",  1,      1,      1,          FShellescape },
-    {   "slide",        2,      NO_MAX, 0,          FSlide  },
-    {   "strlen",       1,      1,      1,          FStrlen },
-    {   "substr",       2,      3,      1,          FSubstr },
-    {   "sunrise",      0,      1,      0,          FSunrise},
-    {   "sunset",       0,      1,      0,          FSunset },
-    {   "time",         2,      2,      1,          FTime   },
-    {   "timepart",     1,      1,      1,          FTimepart },
-    {   "today",        0,      0,      0,          FToday  },
-    {   "trig",         0,      NO_MAX, 0,          FTrig },
-    {   "trigback",     0,      0,      0,          FTrigback },
-    {   "trigdate",     0,      0,      0,          FTrigdate },
-    {   "trigdatetime", 0,      0,      0,          FTrigdatetime },
-    {   "trigdelta",    0,      0,      0,          FTrigdelta },
-    {   "trigduration", 0,      0,      0,          FTrigduration },
-    {   "trigeventduration", 0, 0,      0,          FTrigeventduration },
-    {   "trigeventstart", 0,    0,      0,          FTrigeventstart },
-    {   "trigfrom",     0,      0,      0,          FTrigfrom },
-    {   "trigger",      1,      3,      0,          FTrigger },
-    {   "trigpriority", 0,      0,      0,          FTrigpriority },
-    {   "trigrep",      0,      0,      0,          FTrigrep },
-    {   "trigscanfrom", 0,      0,      0,          FTrigscanfrom },
-    {   "trigtime",     0,      0,      0,          FTrigtime },
-    {   "trigtimedelta",0,      0,      0,          FTrigtimedelta },
-    {   "trigtimerep",  0,      0,      0,          FTrigtimerep },
-    {   "triguntil",    0,      0,      0,          FTriguntil },
-    {   "trigvalid",    0,      0,      0,          FTrigvalid },
-    {   "typeof",       1,      1,      1,          FTypeof },
-    {   "tzconvert",    2,      3,      0,          FTzconvert },
-    {   "upper",        1,      1,      1,          FUpper  },
-    {   "value",        1,      2,      0,          FValue  },
-    {   "version",      0,      0,      1,          FVersion },
-    {   "weekno",       0,      3,      1,          FWeekno },
-    {   "wkday",        1,      1,      1,          FWkday  },
-    {   "wkdaynum",     1,      1,      1,          FWkdaynum },
-    {   "year",         1,      1,      1,          FYear   }
+/*	Name		minargs maxargs	is_constant date_dep  func   */
+
+    {   "abs",          1,      1,      1,    0,         FAbs },
+    {   "access",       2,      2,      0,    0,         FAccess },
+    {   "adawn",        0,      1,      0,    DEP_TODAY, FADawn},
+    {   "adusk",        0,      1,      0,    DEP_TODAY, FADusk},
+    {   "ampm",         1,      3,      1,    0,         FAmpm   },
+    {   "args",         1,      1,      0,    0,         FArgs   },
+    {   "asc",          1,      1,      1,    0,         FAsc    },
+    {   "baseyr",       0,      0,      1,    0,         FBaseyr },
+    {   "char",         1,      NO_MAX, 1,    0,         FChar   },
+    {   "choose",       2,      NO_MAX, 1,    0,         FChoose },
+    {   "coerce",       2,      2,      1,    0,         FCoerce },
+    {   "current",      0,      0,      0,    DEP_TODAY, FCurrent },
+    {   "date",         3,      3,      1,    0,         FDate   },
+    {   "datepart",     1,      1,      1,    0,         FDatepart },
+    {   "datetime",     2,      5,      1,    0,         FDateTime },
+    {   "dawn",         0,      1,      0,    DEP_TODAY, FDawn},
+    {   "day",          1,      1,      1,    0,         FDay    },
+    {   "daysinmon",    2,      2,      1,    0,         FDaysinmon },
+    {   "defined",      1,      1,      0,    0,         FDefined },
+    {   "dosubst",      1,      3,      0,    DEP_TODAY, FDosubst },
+    {   "dusk",         0,      1,      0,    DEP_TODAY, FDusk },
+    {   "easterdate",   1,      1,      0,    0,         FEasterdate },
+    {   "evaltrig",     1,      2,      0,    DEP_TODAY, FEvalTrig },
+    {   "filedate",     1,      1,      0,    0,         FFiledate },
+    {   "filedatetime", 1,      1,      0,    0,         FFiledatetime },
+    {   "filedir",      0,      0,      0,    0,         FFiledir },
+    {   "filename",     0,      0,      0,    0,         FFilename },
+    {   "getenv",       1,      1,      0,    0,         FGetenv },
+    {   "hebdate",      2,      5,      0,    DEP_TODAY, FHebdate },
+    {   "hebday",       1,      1,      0,    0,         FHebday },
+    {   "hebmon",       1,      1,      0,    0,         FHebmon },
+    {   "hebyear",      1,      1,      0,    0,         FHebyear },
+    {   "hour",         1,      1,      1,    0,         FHour   },
+    {   "iif",          1,      NO_MAX, 1,    0,         FIif    },
+    {   "index",        2,      3,      1,    0,         FIndex  },
+    {   "isany",        1,      NO_MAX, 1,    0,         FIsAny  },
+    {   "isdst",        0,      2,      0,    DEP_TODAY, FIsdst },
+    {   "isleap",       1,      1,      1,    0,         FIsleap },
+    {   "isomitted",    1,      1,      0,    0,         FIsomitted },
+    {   "language",     0,      0,      1,    0,         FLanguage },
+    {   "lower",        1,      1,      1,    0,         FLower  },
+    {   "max",          1,      NO_MAX, 1,    0,         FMax    },
+    {   "min",          1,      NO_MAX, 1,    0,         FMin    },
+    {   "minsfromutc",  0,      2,      0,    DEP_TODAY, FMinsfromutc },
+    {   "minute",       1,      1,      1,    0,         FMinute },
+    {   "mon",          1,      1,      1,    0,         FMon    },
+    {   "monnum",       1,      1,      1,    0,         FMonnum },
+    {   "moondate",     1,      3,      0,    DEP_DFLTDATE, FMoondate },
+    {   "moondatetime", 1,      3,      0,    DEP_DFLTDATE, FMoondatetime },
+    {   "moonphase",    0,      2,      0,    DEP_DFLTDATE, FMoonphase },
+    {   "moontime",     1,      3,      0,    DEP_DFLTDATE, FMoontime },
+    {   "ndawn",        0,      1,      0,    DEP_TODAY, FNDawn},
+    {   "ndusk",        0,      1,      0,    DEP_TODAY, FNDusk},
+    {   "nonomitted",   2,      NO_MAX, 0,    0,         FNonomitted },
+    {   "now",          0,      0,      0,    DEP_TODAY, FNow    },
+    {   "ord",          1,      1,      1,    0,         FOrd    },
+    {   "ostype",       0,      0,      1,    0,         FOstype },
+    {   "pad",          3,      4,      1,    0,         FPad    },
+    {   "plural",       1,      3,      1,    0,         FPlural },
+    {   "psmoon",       1,      4,      1,    0,         FPsmoon},
+    {   "psshade",      1,      3,      1,    0,         FPsshade},
+    {   "realcurrent",  0,      0,      0,    DEP_TODAY, FRealCurrent},
+    {   "realnow",      0,      0,      0,    DEP_TODAY, FRealnow},
+    {   "realtoday",    0,      0,      0,    DEP_TODAY, FRealtoday },
+    {   "sgn",          1,      1,      1,    0,         FSgn    },
+    {   "shell",        1,      2,      0,    DEP_TODAY, FShell  },
+    {   "shellescape",  1,      1,      1,    0,         FShellescape },
+    {   "slide",        2,      NO_MAX, 0,    0,         FSlide  },
+    {   "strlen",       1,      1,      1,    0,         FStrlen },
+    {   "substr",       2,      3,      1,    0,         FSubstr },
+    {   "sunrise",      0,      1,      0,    DEP_TODAY, FSunrise},
+    {   "sunset",       0,      1,      0,    DEP_TODAY, FSunset },
+    {   "time",         2,      2,      1,    0,         FTime   },
+    {   "timepart",     1,      1,      1,    0,         FTimepart },
+    {   "today",        0,      0,      0,    DEP_TODAY, FToday  },
+    {   "trig",         0,      NO_MAX, 0,    DEP_TRIG,  FTrig },
+    {   "trigback",     0,      0,      0,    DEP_TRIG,  FTrigback },
+    {   "trigdate",     0,      0,      0,    DEP_TRIG,  FTrigdate },
+    {   "trigdatetime", 0,      0,      0,    DEP_TRIG,  FTrigdatetime },
+    {   "trigdelta",    0,      0,      0,    DEP_TRIG,  FTrigdelta },
+    {   "trigduration", 0,      0,      0,    DEP_TRIG,  FTrigduration },
+    {   "trigeventduration", 0, 0,      0,    DEP_TRIG,  FTrigeventduration },
+    {   "trigeventstart", 0,    0,      0,    DEP_TRIG,  FTrigeventstart },
+    {   "trigfrom",     0,      0,      0,    DEP_TRIG,  FTrigfrom },
+    {   "trigger",      1,      3,      0,    0,         FTrigger },
+    {   "trigpriority", 0,      0,      0,    DEP_TRIG,  FTrigpriority },
+    {   "trigrep",      0,      0,      0,    DEP_TRIG,  FTrigrep },
+    {   "trigscanfrom", 0,      0,      0,    DEP_TRIG,  FTrigscanfrom },
+    {   "trigtime",     0,      0,      0,    DEP_TRIG,  FTrigtime },
+    {   "trigtimedelta",0,      0,      0,    DEP_TRIG,  FTrigtimedelta },
+    {   "trigtimerep",  0,      0,      0,    DEP_TRIG,  FTrigtimerep },
+    {   "triguntil",    0,      0,      0,    DEP_TRIG,  FTriguntil },
+    {   "trigvalid",    0,      0,      0,    DEP_TRIG,  FTrigvalid },
+    {   "typeof",       1,      1,      1,    0,         FTypeof },
+    {   "tzconvert",    2,      3,      0,    DEP_TODAY, FTzconvert },
+    {   "upper",        1,      1,      1,    0,         FUpper  },
+    {   "value",        1,      2,      0,    0,         FValue  },
+    {   "version",      0,      0,      1,    0,         FVersion },
+    {   "weekno",       0,      3,      1,    DEP_DFLTDATE, FWeekno },
+    {   "wkday",        1,      1,      1,    0,         FWkday  },
+    {   "wkdaynum",     1,      1,      1,    0,         FWkdaynum },
+    {   "year",         1,      1,      1,    0,         FYear   }
 };
 
 /* Need a variable here - Func[] array not really visible to outside. */
@@ -351,6 +367,11 @@ int CallFunc(BuiltinFunc *f, int nargs)
 	return r;
     }
 
+    if (f->date_dep == DEP_DFLTDATE) {
+	if (nargs == f->minargs) DateDependent |= DEP_TODAY;
+    } else {
+	DateDependent |= f->date_dep;
+    }
     r = (*(f->func))(info);
     if (r) {
 	DestroyValue(RetVal);
@@ -1634,6 +1655,7 @@ static int FShell(func_info *info)
     DynamicBuffer buf;
     int ch, r;
     FILE *fp;
+    char const *cached;
 
     /* For compatibility with previous versions of Remind, which
        used a static buffer for reading results from shell() command */
@@ -1654,6 +1676,19 @@ static int FShell(func_info *info)
             maxlen = MaxStringLen;
         }
     }
+    if (maxlen < 0) maxlen = 0;
+
+    if (CacheShellOutput) {
+	cached = ShellCacheLookup(ARGSTR(0), maxlen);
+	if (cached) return RetStrVal(cached, info);
+	if (ShellCacheTTL > 0 &&
+	    ReadShellCacheFile(ARGSTR(0), maxlen, &buf) == OK) {
+	    ShellCacheStore(ARGSTR(0), maxlen, DBufValue(&buf));
+	    r = RetStrVal(DBufValue(&buf), info);
+	    DBufFree(&buf);
+	    return r;
+	}
+    }
 
     fp = popen(ARGSTR(0), "r");
     if (!fp) return E_IO_ERR;
@@ -1681,11 +1716,192 @@ static int FShell(func_info *info)
     /* XXX Should we consume remaining output from cmd? */
 
     pclose(fp);
+    if (CacheShellOutput) {
+	ShellCacheStore(ARGSTR(0), maxlen, DBufValue(&buf));
+	if (ShellCacheTTL > 0) {
+	    WriteShellCacheFile(ARGSTR(0), maxlen, DBufValue(&buf));
+	}
+    }
     r = RetStrVal(DBufValue(&buf), info);
     DBufFree(&buf);
     return r;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  The shell() cache                                          */
+/*                                                             */
+/*  Like INCLUDECMD, each unique shell() command is run only   */
+/*  once per Remind run; the output is remembered here.  If    */
+/*  $ShellCacheTTL is positive, output is also saved under     */
+/*  the user's cache directory and reused by later runs for    */
+/*  up to that many seconds.                                   */
+/*                                                             */
+/***************************************************************/
+static char const *ShellCacheLookup(char const *cmd, int maxlen)
+{
+    ShellResult *sr = ShellCache[HashVal(cmd) % SHELL_CACHE_SIZE];
+
+    while (sr) {
+	if (sr->maxlen == maxlen && !strcmp(sr->cmd, cmd)) {
+	    return sr->output;
+	}
+	sr = sr->next;
+    }
+    return NULL;
+}
+
+static void ShellCacheStore(char const *cmd, int maxlen, char const *output)
+{
+    int h = HashVal(cmd) % SHELL_CACHE_SIZE;
+    ShellResult *sr = NEW(ShellResult);
+
+    if (!sr) return;
+    sr->maxlen = maxlen;
+    sr->cmd = StrDup(cmd);
+    sr->output = StrDup(output);
+    if (!sr->cmd || !sr->output) {
+	if (sr->cmd) free(sr->cmd);
+	if (sr->output) free(sr->output);
+	free(sr);
+	return;
+    }
+    sr->next = ShellCache[h];
+    ShellCache[h] = sr;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ClearShellCache                                            */
+/*                                                             */
+/*  Forget all remembered shell() output.                      */
+/*                                                             */
+/***************************************************************/
+void ClearShellCache(void)
+{
+    int i;
+    ShellResult *sr, *next;
+
+    for (i=0; i<SHELL_CACHE_SIZE; i++) {
+	sr = ShellCache[i];
+	while (sr) {
+	    next = sr->next;
+	    free(sr->cmd);
+	    free(sr->output);
+	    free(sr);
+	    sr = next;
+	}
+	ShellCache[i] = NULL;
+    }
+}
+
+/* The cache file for a command is named after the MD5 sum of
+   the maxlen and the command, and holds the command, a NUL and
+   the output. */
+static int ShellCacheFileName(char const *cmd, int maxlen, DynamicBuffer *fname)
+{
+    struct MD5Context ctx;
+    unsigned char sum[16];
+    char hex[40];
+    int i;
+
+    if (GetCacheDir("shell", fname) != OK) return E_CANT_OPEN;
+
+    sprintf(hex, "%d:", maxlen);
+    MD5Init(&ctx);
+    MD5Update(&ctx, (unsigned char *) hex, strlen(hex));
+    MD5Update(&ctx, (unsigned char *) cmd, strlen(cmd));
+    MD5Final(sum, &ctx);
+    hex[0] = '/';
+    for (i=0; i<16; i++) {
+	sprintf(hex + 1 + 2*i, "%02x", (unsigned int) sum[i]);
+    }
+    if (DBufPuts(fname, hex) != OK) {
+	DBufFree(fname);
+	return E_NO_MEM;
+    }
+    return OK;
+}
+
+static int ReadShellCacheFile(char const *cmd, int maxlen, DynamicBuffer *out)
+{
+    DynamicBuffer fname;
+    struct stat sb;
+    FILE *fp;
+    int ch;
+    char const *s;
+
+    DBufInit(&fname);
+    if (ShellCacheFileName(cmd, maxlen, &fname) != OK) return E_CANT_OPEN;
+    fp = fopen(DBufValue(&fname), "r");
+    DBufFree(&fname);
+    if (!fp) return E_CANT_OPEN;
+
+    /* Too old? */
+    if (fstat(fileno(fp), &sb) < 0 ||
+	sb.st_mtime + ShellCacheTTL <= time(NULL) ||
+	sb.st_mtime > time(NULL)) {
+	fclose(fp);
+	return E_CANT_OPEN;
+    }
+
+    /* Check that it really is for this command */
+    for (s = cmd; *s; s++) {
+	if (getc(fp) != (unsigned char) *s) {
+	    fclose(fp);
+	    return E_CANT_OPEN;
+	}
+    }
+    if (getc(fp) != 0) {
+	fclose(fp);
+	return E_CANT_OPEN;
+    }
+
+    DBufFree(out);
+    while ((ch = getc(fp)) != EOF) {
+	if (!ch || DBufPutc(out, (char) ch) != OK) {
+	    fclose(fp);
+	    DBufFree(out);
+	    return E_CANT_OPEN;
+	}
+    }
+    fclose(fp);
+    return OK;
+}
+
+static void WriteShellCacheFile(char const *cmd, int maxlen, char const *output)
+{
+    DynamicBuffer fname, tmpname;
+    FILE *fp;
+    int ok;
+    char suffix[32];
+
+    DBufInit(&fname);
+    DBufInit(&tmpname);
+    if (ShellCacheFileName(cmd, maxlen, &fname) != OK) return;
+    sprintf(suffix, ".%ld.tmp", (long) getpid());
+    if (DBufPuts(&tmpname, DBufValue(&fname)) != OK ||
+	DBufPuts(&tmpname, suffix) != OK) {
+	DBufFree(&fname);
+	DBufFree(&tmpname);
+	return;
+    }
+
+    /* Write to a temporary file and rename it so concurrent runs
+       never see a partial file */
+    fp = fopen(DBufValue(&tmpname), "w");
+    if (fp) {
+	ok = (fwrite(cmd, 1, strlen(cmd)+1, fp) == strlen(cmd)+1 &&
+	      fputs(output, fp) != EOF);
+	if (fclose(fp) == EOF) ok = 0;
+	if (!ok || rename(DBufValue(&tmpname), DBufValue(&fname)) < 0) {
+	    unlink(DBufValue(&tmpname));
+	}
+    }
+    DBufFree(&fname);
+    DBufFree(&tmpname);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  FIsomitted                                                 */
@@ -2720,162 +2936,38 @@ static int FDatepart(func_info *info)
     return OK;
 }
 
-#ifndef HAVE_SETENV
-/* This is NOT a general-purpose replacement for setenv.  It's only
- * used for the timezone stuff! */
-static int setenv(char const *varname, char const *val, int overwrite)
-{
-    static char tzbuf[256];
-    if (strcmp(varname, "TZ")) {
-	fprintf(stderr, "built-in setenv can only be used with TZ\n");
-	abort();
-    }
-    if (!overwrite) {
-	fprintf(stderr, "built-in setenv must have overwrite=1\n");
-	abort();
-    }
-
-    if (strlen(val) > 250) {
-	return -1;
-    }
-    sprintf(tzbuf, "%s=%s", varname, val);
-    return(putenv(tzbuf));
-}
-#endif
-#ifndef HAVE_UNSETENV
-/* This is NOT a general-purpose replacement for unsetenv.  It's only
- * used for the timezone stuff! */
-static void unsetenv(char const *varname)
-{
-    static char tzbuf[8];
-    if (strcmp(varname, "TZ")) {
-	fprintf(stderr, "built-in unsetenv can only be used with TZ\n");
-	abort();
-    }
-    sprintf(tzbuf, "%s", varname);
-    putenv(tzbuf);
-}
-#endif
-
 /***************************************************************/
 /*                                                             */
-/*  FTz                                                        */
+/*  FTzconvert                                                 */
 /*                                                             */
-/*  Conversion between different timezones.                    */
+/*  Conversion between different timezones.  Done by the zone  */
+/*  code in tz.c, so the TZ environment variable is never      */
+/*  touched.                                                   */
 /*                                                             */
 /***************************************************************/
-static int tz_set_tz(char const *tz)
-{
-    int r;
-    if (tz == NULL) {
-       unsetenv("TZ");
-       r = 0;
-    } else {
-	r = setenv("TZ", tz, 1);
-    }
-    tzset();
-    return r;
-}
-
-static int tz_convert(int year, int month, int day,
-		      int hour, int minute,
-		      char const *src_tz, char const *tgt_tz,
-		      struct tm *tm)
-{
-    int r;
-    time_t t;
-    struct tm *res;
-    char const *old_tz;
-
-    /* init tm struct */
-    tm->tm_sec = 0;
-    tm->tm_min = minute;
-    tm->tm_hour = hour;
-    tm->tm_mday = day;
-    tm->tm_mon = month;
-    tm->tm_year = year - 1900;
-    tm->tm_wday = 0; /* ignored by mktime */
-    tm->tm_yday = 0; /* ignored by mktime */
-    tm->tm_isdst = -1;  /* information not available */
-
-    /* backup old TZ env var */
-    old_tz = getenv("TZ");
-    if (tgt_tz == NULL) {
-	tgt_tz = old_tz;
-    }
-
-    /* set source TZ */
-    r = tz_set_tz(src_tz);
-    if (r == -1) {
-	return -1;
-    }
-
-    /* create timestamp in UTC */
-    t = mktime(tm);
-
-    if (t == (time_t) -1) {
-	tz_set_tz(old_tz);
-	return -1;
-    }
-
-    /* set target TZ */
-    r = tz_set_tz(tgt_tz);
-    if (r == -1) {
-	tz_set_tz(old_tz);
-	return -1;
-    }
-
-    /* convert to target TZ */
-    res = localtime_r(&t, tm);
-
-    /* restore old TZ */
-    tz_set_tz(old_tz);
-
-    /* return result */
-    if (res == NULL) {
-	return -1;
-    } else {
-	return 1;
-    }
-}
-
 static int FTzconvert(func_info *info)
 {
-    int year, month, day, hour, minute, r;
-    int jul, tim;
-    struct tm tm;
+    int t;
 
     if (ARG(0).type != DATETIME_TYPE ||
 	ARG(1).type != STR_TYPE) return E_BAD_TYPE;
     if (Nargs == 3 && ARG(2).type != STR_TYPE) return E_BAD_TYPE;
 
-    FromJulian(DATEPART(ARG(0)), &year, &month, &day);
+    t = TzLocalToUTC(ARGSTR(1), ARGV(0), NULL, NULL);
+    t = TzUTCToLocal((Nargs == 3) ? ARGSTR(2) : NULL, t, NULL, NULL);
 
-    r = TIMEPART(ARG(0));
-    hour = r / 60;
-    minute = r % 60;
-
-    if (Nargs == 2) {
-	r = tz_convert(year, month, day, hour, minute,
-		       ARGSTR(1), NULL, &tm);
-    } else {
-	r = tz_convert(year, month, day, hour, minute,
-		       ARGSTR(1), ARGSTR(2), &tm);
+    if (t < 0 || t / MINUTES_PER_DAY > Julian(BASE+YR_RANGE, 11, 31)) {
+	return E_CANT_CONVERT_TZ;
     }
-
-    if (r == -1) return E_CANT_CONVERT_TZ;
-
-    jul = Julian(tm.tm_year + 1900, tm.tm_mon, tm.tm_mday);
-    tim = tm.tm_hour * 60 + tm.tm_min;
     RetVal.type = DATETIME_TYPE;
-    RETVAL = jul * MINUTES_PER_DAY + tim;
+    RETVAL = t;
     return OK;
 }
 
 static int
 FSlide(func_info *info)
 {
-    int r, omit, d, i, localomit, amt;
+    int r, d, i, localomit, amt, limit, steps;
     Token tok;
 
     if (!HASDATE(ARG(0))) return E_BAD_TYPE;
@@ -2897,20 +2989,16 @@ FSlide(func_info *info)
     /* If ALL weekdays are omitted... barf! */
     if (localomit == 127 && amt != 0) return E_2MANY_LOCALOMIT;
     if (amt > 0) {
-	while(amt) {
-	    d++;
-	    r = IsOmitted(d, localomit, NULL,&omit);
-	    if (r) return r;
-	    if (!omit) amt--;
-	}
-    } else {
-	while(amt) {
-	    d--;
-	    if (d < 0) return E_DATE_OVER;
-	    r = IsOmitted(d, localomit, NULL,&omit);
-	    if (r) return r;
-	    if (!omit) amt++;
-	}
+	limit = Julian(BASE+YR_RANGE, 11, 31) - d;
+	r = NonOmittedSteps(d+1, 1, amt, localomit, NULL, limit, &steps);
+	if (r) return r;
+	if (steps > limit) return E_DATE_OVER;
+	d += steps;
+    } else if (amt < 0) {
+	r = NonOmittedSteps(d-1, -1, -amt, localomit, NULL, d, &steps);
+	if (r) return r;
+	if (steps > d) return E_DATE_OVER;
+	d -= steps;
     }
     RetVal.type = DATE_TYPE;
     RETVAL = d;
@@ -2921,7 +3009,6 @@ static int
 FNonomitted(func_info *info)
 {
     int d1, d2, ans, localomit, i;
-    int omit, r;
     Token tok;
 
     if (!HASDATE(ARG(0)) ||
@@ -2940,14 +3027,7 @@ FNonomitted(func_info *info)
 	localomit |= (1 << tok.val);
     }
 
-    ans = 0;
-    while (d1 < d2) {
-	r = IsOmitted(d1++, localomit, NULL, &omit);
-	if (r) return r;
-	if (!omit) {
-	    ans++;
-	}
-    }
+    ans = CountNonOmitted(d1, d2, localomit);
     RetVal.type = INT_TYPE;
     RETVAL = ans;
     return OK;
@@ -52,6 +52,8 @@ EXTERN  uid_t   TrustedUsers[MAX_TRUSTED_USERS];
 EXTERN  INIT(   int     NumTrustedUsers, 0);
 EXTERN  INIT(   char    const *MsgCommand, NULL);
 EXTERN  INIT(	int     ShowAllErrors, 0);
+EXTERN  INIT(   int     NumErrorsSeen, 0);
+EXTERN  INIT(   int     SuppressErrors, 0);
 EXTERN  INIT(	int     DebugFlag, 0);
 EXTERN  INIT(   int	DoCalendar, 0);
 EXTERN  INIT(   int     DoSimpleCalendar, 0);
@@ -63,6 +65,7 @@ EXTERN  INIT(   int     PsCal, 0);
 EXTERN  INIT(   int     CalWidth, -1);
 EXTERN  INIT(   int     CalWeeks, 0);
 EXTERN  INIT(   int     CalMonths, 0);
+EXTERN  INIT(   int     CalJobs, 1);
 EXTERN  INIT(	int 	Hush, 0);
 EXTERN  INIT(	int 	NextMode, 0);
 EXTERN  INIT(	int 	InfiniteDelta, 0);
@@ -96,6 +99,8 @@ EXTERN  INIT(   int     SynthesizeTags, 0);
 EXTERN  INIT(   int     ScFormat, SC_AMPM);
 EXTERN  INIT(   int     MaxSatIter, 1000);
 EXTERN  INIT(   int     MaxStringLen, MAX_STR_LEN);
+EXTERN  INIT(   int     CacheShellOutput, 1);
+EXTERN  INIT(   int     ShellCacheTTL, 0);
 EXTERN  INIT(	char	*FileName, NULL);
 EXTERN	INIT(	int	UseStdin, 0);
 EXTERN  INIT(   int     PurgeMode, 0);
@@ -109,8 +114,14 @@ EXTERN  TimeTrig LastTimeTrig;
 EXTERN  INIT(   int     LastTriggerDate, 0);
 EXTERN  INIT(   int     LastTriggerTime, 0);
 EXTERN  INIT(   int     ShouldCache, 0);
+EXTERN  INIT(   int     UseDiskCache, 0);
+EXTERN  INIT(   char const *QueryDates, NULL);
+EXTERN  INIT(   int     QueryJSON, 0);
+EXTERN  INIT(   char const *ServerSocket, NULL);
+EXTERN  INIT(   char const *BatchManifest, NULL);
 EXTERN  char const   *CurLine;
 EXTERN  INIT(   int     NumTriggered, 0);
+EXTERN  INIT(   int     DateDependent, 0);
 EXTERN  int ArgC;
 EXTERN  char const **ArgV;
 EXTERN  INIT(   int     CalLines, CAL_LINES);
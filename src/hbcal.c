@@ -63,6 +63,56 @@ static char MaxMonLen[] = {
 
 static char HebIsLeap[] = {0,0,1,0,0,1,0,1,0,0,1,0,0,1,0,0,1,0,1};
 
+/* Number of Hebrew years HebYearInfo() remembers; must be a power
+   of two */
+#define HEB_YEAR_CACHE 64
+
+/* The layout of one Hebrew year */
+typedef struct {
+    int year;            /* The Hebrew year */
+    int rh;              /* Julian date of Rosh Hashana */
+    int len;             /* Days in the year; 0 if the slot is unused */
+    char monlen[14];     /* Month lengths, as from DaysInHebMonths() */
+    short monstart[14];  /* Days from Rosh Hashana to each month */
+} HebYear;
+
+static HebYear HebYearCache[HEB_YEAR_CACHE];
+
+static HebYear const *HebYearInfo(int y);
+
+/***************************************************************/
+/*                                                             */
+/*  HebYearInfo                                                */
+/*                                                             */
+/*  Return the layout of Hebrew year y.  The molad arithmetic  */
+/*  is only done the first time a year is asked for; searches  */
+/*  keep going back to the same few years.                     */
+/*                                                             */
+/***************************************************************/
+static HebYear const *HebYearInfo(int y)
+{
+    HebYear *h = &HebYearCache[(unsigned int) y & (HEB_YEAR_CACHE-1)];
+    long thisyear, nextyear;
+    char const *monlen;
+    int m, start;
+
+    if (h->len && h->year == y) return h;
+
+    thisyear = DaysToHebYear(y-3744);
+    nextyear = DaysToHebYear(y-3743);
+    h->year = y;
+    h->rh = (int) (thisyear - CORRECTION);
+    h->len = (int) (nextyear - thisyear);
+    monlen = DaysInHebMonths(h->len);
+    start = 0;
+    for (m=0; m<14; m++) {
+	h->monlen[m] = monlen[m];
+	h->monstart[m] = start;
+	start += monlen[m];
+    }
+    return h;
+}
+
 /***************************************************************/
 /*                                                             */
 /*  RoshHashana                                                */
@@ -73,9 +123,7 @@ static char HebIsLeap[] = {0,0,1,0,0,1,0,1,0,0,1,0,0,1,0,0,1,0,1};
 /***************************************************************/
 int RoshHashana(int i)
 {
-    long j;
-    j = DaysToHebYear(i-3744) - CORRECTION;
-    return (int) j; /* No overflow check... very trusting! */
+    return HebYearInfo(i)->rh; /* No overflow check... very trusting! */
 }
  
 /***************************************************************/
@@ -121,11 +169,7 @@ long DaysToHebYear(int y)
 /***************************************************************/
 int DaysInHebYear(int y)
 {
-    long thisyear, nextyear;
-
-    thisyear = DaysToHebYear(y-3744);
-    nextyear = DaysToHebYear(y-3743);
-    return (int) (nextyear - thisyear);
+    return HebYearInfo(y)->len;
 }
 
 /***************************************************************/
@@ -164,26 +208,15 @@ char const *DaysInHebMonths(int ylen)
 /***************************************************************/
 int HebToJul(int hy, int hm, int hd)
 {
-    int ylen;
-    char const *monlens;
-    int rh;
-    int m;
+    HebYear const *h;
 
     /* Do some range checking */
     if (hy - 3761 < BASE || hy - 3760 > BASE+YR_RANGE) return -1;
 
-    ylen = DaysInHebYear(hy);
-    monlens = DaysInHebMonths(ylen);
-
-    /* Get the Rosh Hashana of the year */
-    rh = RoshHashana(hy);
-
-    /* Bump up to the appropriate month */
-    for (m=0; m<hm; m++) rh += monlens[m];
-
-    /* Add in appropriate number of days */
-    rh += hd - 1;
-    return rh;
+    /* Rosh Hashana of the year, bumped up to the appropriate month,
+       plus the appropriate number of days */
+    h = HebYearInfo(hy);
+    return h->rh + h->monstart[hm] + hd - 1;
 }
 
 /***************************************************************/
@@ -198,29 +231,23 @@ int HebToJul(int hy, int hm, int hd)
 void JulToHeb(int jul, int *hy, int *hm, int *hd)
 {
     int y, m, d;
-    int rh;
-    int ylen;
-    char const *monlen;
-    /* Get the common year */
-    FromJulian(jul, &y, &m, &d);
-    y += 3763; /* Over-estimate a bit to be on the safe side below... */
+    HebYear const *h;
 
-    /* Find the RH just before desired date */
-    while ((rh=RoshHashana(y))>jul) y--;
+    /* Get the common year.  Rosh Hashana always falls in the autumn,
+       so the Hebrew year is this one or the one before */
+    FromJulian(jul, &y, &m, &d);
+    y += 3761;
+    h = HebYearInfo(y);
+    while (h->rh > jul) h = HebYearInfo(--y);
 
     /* Got the year - now find the month */
-    jul -= rh;
-    ylen = DaysInHebYear(y);
-    monlen = DaysInHebMonths(ylen);
-    m = 0;
-    while((jul >= monlen[m]) || !monlen[m]) {
-	jul -= monlen[m];
-	m++;
-    }
+    jul -= h->rh;
+    m = 13;
+    while (m && (jul < h->monstart[m] || !h->monlen[m])) m--;
 
     *hy = y;
     *hm = m;
-    *hd = jul+1;
+    *hd = jul - h->monstart[m] + 1;
 }
 
 /***************************************************************/
@@ -293,7 +320,6 @@ int GetValidHebDate(int yin, int min, int din, int adarbehave,
                            int *mout, int *dout, int jahr)
 {
     char const *monlen;
-    int ylen;
 
     *mout = min;
     *dout = din;
@@ -304,8 +330,7 @@ int GetValidHebDate(int yin, int min, int din, int adarbehave,
 	return E_BAD_HEBDATE;
     }
 
-    ylen = DaysInHebYear(yin);
-    monlen = DaysInHebMonths(ylen);
+    monlen = HebYearInfo(yin)->monlen;
 
     /* Convert ADAR as necessary */
     if (min == ADAR) {
@@ -448,12 +473,10 @@ int GetNextHebrewDate(int julstart, int hm, int hd,
 int ComputeJahr(int y, int m, int d, int *ans)
 {
     char const *monlen;
-    int len;
 
     *ans = JAHR_NONE;
 
-    len = DaysInHebYear(y);
-    monlen = DaysInHebMonths(len);
+    monlen = HebYearInfo(y)->monlen;
 
 /* Check for Adar A */
     if (m == ADARA && monlen[m] == 0) {
@@ -478,8 +501,7 @@ int ComputeJahr(int y, int m, int d, int *ans)
     }
 
 /* Get lengths of months in year following jahrzeit */
-    len = DaysInHebYear(y+1);
-    monlen = DaysInHebMonths(len);
+    monlen = HebYearInfo(y+1)->monlen;
 
     if (d > monlen[m]) *ans = JAHR_FORWARD;
     else               *ans = JAHR_BACKWARD;
@@ -88,12 +88,21 @@ while (isdigit(*(s))) {    \
 
 static void ChgUser(char const *u);
 static void InitializeVar(char const *str);
+static void AddInitVarArg(char const *str);
 
 static char const *BadDate = "Illegal date on command line\n";
 static void AddTrustedUser(char const *username);
+static void ProcessLongOption(char const *arg);
 
 static DynamicBuffer default_filename_buf;
 
+/* What the command line set up, so that ResetInterpreter() can go
+   back to it */
+static char const **InitVarArgs = NULL;
+static int NumInitVarArgs = 0;
+static int InitDebugFlag;
+static int InitRunDisabled;
+
 /***************************************************************/
 /*                                                             */
 /*  DefaultFilename                                            */
@@ -217,6 +226,10 @@ void InitRemind(int argc, char const *argv[])
 	    i--;
 	    break;
 	}
+	if (*arg == '-') {
+	    ProcessLongOption(arg+1);
+	    continue;
+	}
 	while (*arg) {
 	    switch(*arg++) {
             case '+':
@@ -261,6 +274,7 @@ void InitRemind(int argc, char const *argv[])
             case 'i':
 	    case 'I':
 		InitializeVar(arg);
+		AddInitVarArg(arg);
 		while(*arg) arg++;
 		break;
 
@@ -562,8 +576,11 @@ void InitRemind(int argc, char const *argv[])
 	}
     }
 
-    /* Get the filename. */
-    if (!InvokedAsRem) {
+    /* Get the filename.  A batch run takes its files from the
+       manifest instead */
+    if (BatchManifest && i >= argc) {
+	InitialFile = NULL;
+    } else if (!InvokedAsRem) {
 	if (i >= argc) {
 	    Usage();
 	    exit(EXIT_FAILURE);
@@ -669,6 +686,58 @@ void InitRemind(int argc, char const *argv[])
     if (CalculateUTC)
 	(void) CalcMinsFromUTC(JulianToday, SystemTime(0)/60,
 			       &MinsFromUTC, NULL);
+
+    InitDebugFlag = DebugFlag;
+    InitRunDisabled = RunDisabled;
+    SaveSysVars();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ResetInterpreter                                           */
+/*                                                             */
+/*  Undo everything the reminder file did to the interpreter:  */
+/*  its variables, functions, system variables, banner, debug  */
+/*  flags and RUN OFF.  The -i options are applied again, so   */
+/*  the file can be run once more just as if Remind had been   */
+/*  restarted with the same command line.                      */
+/*                                                             */
+/***************************************************************/
+void ResetInterpreter(void)
+{
+    int i;
+
+    DestroyUserFuncs();
+    DestroyVars(1);
+    RestoreSysVars();
+    DebugFlag = InitDebugFlag;
+    RunDisabled = InitRunDisabled;
+    DBufFree(&Banner);
+    DBufPuts(&Banner, L_BANNER);
+
+    for (i=0; i<NumInitVarArgs; i++) {
+	InitializeVar(InitVarArgs[i]);
+    }
+    if (CalculateUTC)
+	(void) CalcMinsFromUTC(JulianToday, SystemTime(0)/60,
+			       &MinsFromUTC, NULL);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  AddInitVarArg                                              */
+/*                                                             */
+/*  Remember a -i option for ResetInterpreter().               */
+/*                                                             */
+/***************************************************************/
+static void AddInitVarArg(char const *str)
+{
+    char const **a;
+
+    a = realloc(InitVarArgs, (NumInitVarArgs+1) * sizeof(char const *));
+    if (!a) return;
+    InitVarArgs = a;
+    InitVarArgs[NumInitVarArgs++] = str;
 }
 
 /***************************************************************/
@@ -714,9 +783,52 @@ void Usage(void)
     fprintf(ErrFp, " -m     Start calendar with Monday rather than Sunday\n");
     fprintf(ErrFp, " -y     Synthesize tags for tagless reminders\n");
     fprintf(ErrFp, " -j[n]  Run in 'purge' mode.  [n = INCLUDE depth]\n");
+    fprintf(ErrFp, " --cache Keep parsed reminder files in an on-disk cache\n");
     exit(EXIT_FAILURE);
 }
 #endif /* L_USAGE_OVERRIDE */
+/***************************************************************/
+/*                                                             */
+/*  ProcessLongOption                                          */
+/*                                                             */
+/*  Handle a --name command-line option.  arg points past the  */
+/*  two dashes.                                                */
+/*                                                             */
+/***************************************************************/
+static void ProcessLongOption(char const *arg)
+{
+    if (!strcmp(arg, "cache")) {
+	UseDiskCache = 1;
+	return;
+    }
+    if (!strncmp(arg, "dates=", 6)) {
+	QueryDates = arg + 6;
+	return;
+    }
+    if (!strncmp(arg, "batch=", 6)) {
+	BatchManifest = arg + 6;
+	return;
+    }
+    if (!strncmp(arg, "server=", 7)) {
+	ServerSocket = arg + 7;
+	return;
+    }
+    if (!strcmp(arg, "json")) {
+	QueryJSON = 1;
+	return;
+    }
+    if (!strncmp(arg, "jobs=", 5)) {
+	arg += 5;
+	PARSENUM(CalJobs, arg);
+	if (*arg || CalJobs < 1) {
+	    fprintf(ErrFp, "Invalid value for '--jobs'\n");
+	    CalJobs = 1;
+	}
+	return;
+    }
+    fprintf(ErrFp, "Unknown option '--%s'\n", arg);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  ChgUser                                                    */
@@ -18,6 +18,7 @@
 #include <signal.h>
 #include <string.h>
 #include <stdarg.h>
+#include <errno.h>
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
 #endif
@@ -43,6 +44,13 @@
 #include "err.h"
 
 static void DoReminders(void);
+static void RunDateQueries(void);
+static void QueryDateList(char const *list);
+static void QueryDateItem(char const *item);
+static void RunQueryDate(int jul);
+/* State of a --dates run */
+static int QueryIgnoreOnce;
+static int NumQueries;
 
 /***************************************************************/
 /***************************************************************/
@@ -53,8 +61,6 @@ static void DoReminders(void);
 /***************************************************************/
 int main(int argc, char *argv[])
 {
-    int pid;
-
 #ifdef HAVE_SETLOCALE
     setlocale(LC_ALL, "");
 #endif
@@ -67,8 +73,34 @@ int main(int argc, char *argv[])
     ArgV = (char const **) argv;
 
     InitRemind(argc, (char const **) argv);
+
+    /* Running a whole manifest of reminder files? */
+    if (BatchManifest) {
+	return RunBatch();
+    }
+    return RunRemind();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunRemind                                                  */
+/*                                                             */
+/*  Do whatever the command line (already processed by         */
+/*  InitRemind) asked for.  Returns the exit status.           */
+/*                                                             */
+/***************************************************************/
+int RunRemind(void)
+{
+    int pid;
+
     ClearLastTriggers();
 
+    /* Answering requests on a socket? */
+    if (ServerSocket) {
+	RunServer();
+	return 0;
+    }
+
     if (DoCalendar || (DoSimpleCalendar && (!NextMode || PsCal))) {
 	ProduceCalendar();
 	return 0;
@@ -80,29 +112,18 @@ int main(int argc, char *argv[])
 	return 0;
     }
 
-    /* Not doing a calendar.  Do the regular remind loop */
-    ShouldCache = (Iterations > 1);
-
-    while (Iterations--) {
-	DoReminders();
+    /* Evaluating the file for a list of dates? */
+    if (QueryDates) {
+	RunDateQueries();
+	return 0;
+    }
 
-	if (DebugFlag & DB_DUMP_VARS) {
-	    DumpVarTable();
-	    DumpSysVarByName(NULL);
-	}
+    /* Not doing a calendar.  Do the regular remind loop.  A daemon
+       caches files so it can reload without re-reading unchanged ones */
+    ShouldCache = (Iterations > 1 || Daemon);
 
-	if (!Hush) {
-	    if (DestroyOmitContexts())
-		Eprint("%s", ErrMsg[E_PUSH_NOPOP]);
-	    if (!Daemon && !NextMode && !NumTriggered && !NumQueued) {
-		printf("%s\n", ErrMsg[E_NOREMINDERS]);
-	    } else if (!Daemon && !NextMode && !NumTriggered) {
-		printf(ErrMsg[M_QUEUED], NumQueued);
-	    }
-	}
-
-	/* If there are sorted reminders, handle them */
-	if (SortByDate) IssueSortedReminders();
+    while (Iterations--) {
+	RunReminderPass();
 
 	/* If there are any background reminders queued up, handle them */
 	if (NumQueued || Daemon) {
@@ -154,6 +175,254 @@ PerIterationInit(void)
     ClearLastTriggers();
 }
 
+/***************************************************************/
+/*                                                             */
+/*  ReloadReminders                                            */
+/*                                                             */
+/*  Run through the reminder file again without restarting,    */
+/*  as the daemon does when the file changes, the date rolls   */
+/*  over or it is told to REREAD.  Only files that changed on  */
+/*  disk are read again; the rest come from the cache.  The    */
+/*  interpreter starts from the state the command line left.   */
+/*                                                             */
+/***************************************************************/
+void ReloadReminders(void)
+{
+    int y, m, d;
+    int today = SystemDate(&y, &m, &d);
+
+    /* Re-read zone files in case the system time zone changed, and
+       re-run shell() commands */
+    TzClearCache();
+    ClearShellCache();
+
+    if (today != RealToday) {
+	/* Move to the new date unless one was given on the command line */
+	if (JulianToday == RealToday) {
+	    JulianToday = today;
+	    CurYear = y;
+	    CurMon = m;
+	    CurDay = d;
+	}
+	RealToday = today;
+    }
+
+    /* Forget what the last run of the file set up */
+    ResetInterpreter();
+    PerIterationInit();
+    RefreshFileCache(1);
+    RunReminderPass();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetToday                                                   */
+/*                                                             */
+/*  Make jul the date for which reminders are processed.       */
+/*                                                             */
+/***************************************************************/
+void SetToday(int jul)
+{
+    int y, m, d;
+
+    JulianToday = jul;
+    FromJulian(jul, &y, &m, &d);
+    CurYear = y;
+    CurMon = m;
+    CurDay = d;
+    if (CalculateUTC)
+	(void) CalcMinsFromUTC(JulianToday, SystemTime(0)/60,
+			       &MinsFromUTC, NULL);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunReminderPass                                            */
+/*                                                             */
+/*  Process the reminder file once and issue what it produced. */
+/*                                                             */
+/***************************************************************/
+void RunReminderPass(void)
+{
+    DoReminders();
+
+    if (DebugFlag & DB_DUMP_VARS) {
+	DumpVarTable();
+	DumpSysVarByName(NULL);
+    }
+
+    if (!Hush) {
+	if (DestroyOmitContexts())
+	    Eprint("%s", ErrMsg[E_PUSH_NOPOP]);
+	if (!Daemon && !NextMode && !NumTriggered && !NumQueued) {
+	    printf("%s\n", ErrMsg[E_NOREMINDERS]);
+	} else if (!Daemon && !NextMode && !NumTriggered) {
+	    printf(ErrMsg[M_QUEUED], NumQueued);
+	}
+    }
+
+    /* If there are sorted reminders, handle them */
+    if (SortByDate) IssueSortedReminders();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunDateQueries                                             */
+/*                                                             */
+/*  Handle --dates: process the reminder file once for each    */
+/*  date in the list given on the command line, or read from   */
+/*  standard input if the list is "-".  The file is read only  */
+/*  once; later passes use the cached and compiled lines.      */
+/*                                                             */
+/***************************************************************/
+static void RunDateQueries(void)
+{
+    DynamicBuffer buf;
+
+    ShouldCache = 1;
+    DontQueue = 1;
+    Daemon = 0;
+    QueryIgnoreOnce = IgnoreOnce;
+    NumQueries = 0;
+
+    if (QueryJSON) printf("[\n");
+    if (!strcmp(QueryDates, "-")) {
+	if (UseStdin) {
+	    fprintf(ErrFp, "Can't read both reminders and dates from standard input\n");
+	    exit(1);
+	}
+	DBufInit(&buf);
+	while (DBufGets(&buf, stdin) == OK) {
+	    if (!DBufLen(&buf) && feof(stdin)) break;
+	    QueryDateList(DBufValue(&buf));
+	}
+	DBufFree(&buf);
+    } else {
+	QueryDateList(QueryDates);
+    }
+    if (QueryJSON) printf("%s]\n", NumQueries ? "\n" : "");
+}
+
+/***************************************************************/
+/*                                                             */
+/*  QueryDateList                                              */
+/*                                                             */
+/*  Run the queries in a list of dates or date ranges          */
+/*  separated by commas or whitespace.                         */
+/*                                                             */
+/***************************************************************/
+static void QueryDateList(char const *list)
+{
+    DynamicBuffer item;
+
+    DBufInit(&item);
+    while (*list) {
+	if (*list == ',' || isspace(*list)) {
+	    list++;
+	    continue;
+	}
+	DBufFree(&item);
+	while (*list && *list != ',' && !isspace(*list)) {
+	    DBufPutc(&item, *list++);
+	}
+	QueryDateItem(DBufValue(&item));
+    }
+    DBufFree(&item);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  QueryDateItem                                              */
+/*                                                             */
+/*  Run the queries for a single date (YYYY-MM-DD) or an       */
+/*  inclusive range of dates (YYYY-MM-DD..YYYY-MM-DD).         */
+/*                                                             */
+/***************************************************************/
+static void QueryDateItem(char const *item)
+{
+    char const *s = item;
+    int from, to, tim;
+
+    if (ParseLiteralDate(&s, &from, &tim) || tim != NO_TIME) {
+	fprintf(ErrFp, "%s: `%s'\n", ErrMsg[E_BAD_DATE], item);
+	return;
+    }
+    to = from;
+    if (!strncmp(s, "..", 2)) {
+	s += 2;
+	if (ParseLiteralDate(&s, &to, &tim) || tim != NO_TIME || to < from) {
+	    fprintf(ErrFp, "%s: `%s'\n", ErrMsg[E_BAD_DATE], item);
+	    return;
+	}
+    }
+    if (*s) {
+	fprintf(ErrFp, "%s: `%s'\n", ErrMsg[E_BAD_DATE], item);
+	return;
+    }
+    while (from <= to) {
+	RunQueryDate(from++);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RunQueryDate                                               */
+/*                                                             */
+/*  Process the reminder file for one date of a --dates run,   */
+/*  preceded by a line naming the date.  With --json, the      */
+/*  output is collected and written as a JSON object instead.  */
+/*                                                             */
+/***************************************************************/
+static void RunQueryDate(int jul)
+{
+    int y, m, d;
+    FILE *tmp = NULL;
+    int saved = -1;
+    char buf[4096];
+    size_t n;
+
+    if (NumQueries++) {
+	PerIterationInit();
+    }
+    SetToday(jul);
+    IgnoreOnce = (QueryIgnoreOnce || JulianToday != RealToday);
+
+    if (!QueryJSON) {
+	FromJulian(jul, &y, &m, &d);
+	printf("# remind date %04d-%02d-%02d\n", y, m+1, d);
+	RunReminderPass();
+	fflush(stdout);
+	return;
+    }
+
+    /* Collect the output in a temporary file */
+    fflush(stdout);
+    tmp = tmpfile();
+    if (tmp) saved = dup(STDOUT_FILENO);
+    if (saved < 0) {
+	fprintf(ErrFp, "Can't create temporary file: %s\n", strerror(errno));
+	exit(1);
+    }
+    dup2(fileno(tmp), STDOUT_FILENO);
+    RunReminderPass();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    if (NumQueries > 1) printf(",\n");
+    printf("{");
+    PrintJSONKeyPairDate("date", jul);
+    printf("\"output\":\"");
+    rewind(tmp);
+    while ((n = fread(buf, 1, sizeof(buf)-1, tmp)) > 0) {
+	buf[n] = 0;
+	PrintJSONString(buf);
+    }
+    fclose(tmp);
+    printf("\"}");
+    fflush(stdout);
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DoReminders                                                */
@@ -329,39 +598,50 @@ int Julian(int year, int month, int day)
 /*                                                             */
 /*  FromJulian                                                 */
 /*                                                             */
-/*  Convert a Julian date to year, month, day.                 */
+/*  Convert a Julian date to year, month, day without any      */
+/*  loops.  Days are counted from 1 March of year 0 of the     */
+/*  proleptic Gregorian calendar, so that leap days fall at    */
+/*  the end of a year; the 400-year cycle, the year within it  */
+/*  and the day within that year then follow by division, and  */
+/*  the months from March on have the regular lengths          */
+/*  31 30 31 30 31 in groups of 153 days.                      */
 /*                                                             */
 /***************************************************************/
-void FromJulian(int jul, int *y, int *m, int *d)
-{
-    int try_yr = (jul / 365) + BASE;
-    int try_mon = 0;
-    int t;
 
-    /* Inline code for speed... */
-    int y1 = BASE-1, y2 = try_yr-1;
-    int y4 = (y2 / 4) - (y1 / 4);  /* Correct for leap years */
-    int y100 = (y2 / 100) - (y1 / 100); /* Don't count multiples of 100... */
-    int y400 = (y2 / 400) - (y1 / 400); /* ... but do count multiples of 400 */
+/* Days from 1 March of year 0 to 1 January BASE */
+#define MARCH_ZERO ((BASE-1) * 365 + (BASE-1) / 4 - (BASE-1) / 100 + \
+		    (BASE-1) / 400 + 306)
 
-    int try_jul= 365 * (try_yr-BASE) + y4 - y100 + y400;
+void FromJulian(int jul, int *y, int *m, int *d)
+{
+    int z = jul + MARCH_ZERO;
+    int era = ((z >= 0) ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = (mp < 10) ? mp + 2 : mp - 10;
+    *y = era * 400 + yoe + (mp >= 10);
+}
 
-    while (try_jul > jul) {
-	try_yr--;
-	try_jul -= DaysInYear(try_yr);
-    }
-    jul -= try_jul;
+/***************************************************************/
+/*                                                             */
+/*  FromJulianArray                                            */
+/*                                                             */
+/*  Convert the n Julian dates in jul to years, months and     */
+/*  days.  FromJulian() has no branches, so the compiler can   */
+/*  vectorize this loop.                                       */
+/*                                                             */
+/***************************************************************/
+void FromJulianArray(int const *jul, int n, int *y, int *m, int *d)
+{
+    int i;
 
-    t = DaysInMonth(try_mon, try_yr);
-    while (jul >= t) {
-	jul -= t;
-	try_mon++;
-	t = DaysInMonth(try_mon, try_yr);
+    for (i=0; i<n; i++) {
+	FromJulian(jul[i], &y[i], &m[i], &d[i]);
     }
-    *y = try_yr;
-    *m = try_mon;
-    *d = jul + 1;
-    return;
 }
 
 /***************************************************************/
@@ -577,6 +857,8 @@ void Wprint(char const *fmt, ...)
 {
     va_list argptr;
 
+    NumErrorsSeen++;
+    if (SuppressErrors) return;
 
     if (FileName) {
 	if (strcmp(FileName, "-"))
@@ -600,6 +882,9 @@ void Eprint(char const *fmt, ...)
 {
     va_list argptr;
 
+    NumErrorsSeen++;
+    if (SuppressErrors) return;
+
     /* Check if more than one error msg. from this line */
     if (!FreshLine && !ShowAllErrors) return;
 
@@ -1138,8 +1423,8 @@ int DoErrMsg(ParsePtr p)
 /*                                                             */
 /*  CalcMinsFromUTC                                            */
 /*                                                             */
-/*  Attempt to calculate the minutes from UTC for a specific   */
-/*  date.                                                      */
+/*  Calculate the minutes from UTC for a specific local date   */
+/*  and time.                                                  */
 /*                                                             */
 /***************************************************************/
 
@@ -1156,51 +1441,20 @@ static int FoldArray[2][7] = {
 
 int CalcMinsFromUTC(int jul, int tim, int *mins, int *isdst)
 {
-
-/* Convert jul and tim to an Unix tm struct */
     int yr, mon, day;
-    int tdiff;
-    struct tm local, utc, *temp;
-    time_t loc_t, utc_t;
-    int isdst_tmp;
-
-    FromJulian(jul, &yr, &mon, &day);
-
-/* If the year is greater than 2037, some Unix machines have problems.
-   Fold it back to a "similar" year and trust that the UTC calculations
-   are still valid... */
-    if (FoldYear && yr>2037) {
-	jul = Julian(yr, 0, 1);
-	yr = FoldArray[IsLeapYear(yr)][jul%7];
+
+/* If the year is greater than 2037, fold it back to a "similar" year
+   if asked to.  The time-zone code in tz.c doesn't need this, but
+   $FoldYear is honoured so results don't change underfoot. */
+    if (FoldYear) {
+	FromJulian(jul, &yr, &mon, &day);
+	if (yr > 2037) {
+	    jul = Julian(yr, 0, 1);
+	    yr = FoldArray[IsLeapYear(yr)][jul%7];
+	    jul = Julian(yr, mon, day);
+	}
     }
-    local.tm_sec = 0;
-    local.tm_min = tim % 60;
-    local.tm_hour = tim / 60;
-    local.tm_mday = day;
-    local.tm_mon = mon;
-    local.tm_year = yr-1900;
-    local.tm_isdst = -1;  /* We don't know whether or not dst is in effect */
-
-
-    /* Horrible contortions to get minutes from UTC portably */
-    loc_t = mktime(&local);
-    if (loc_t == -1) return 1;
-    isdst_tmp = local.tm_isdst;
-    local.tm_isdst = 0;
-    loc_t = mktime(&local);
-    if (loc_t == -1) return 1;
-    temp = gmtime(&loc_t);
-    utc = *temp;
-    utc.tm_isdst = 0;
-    utc_t = mktime(&utc);
-    if (utc_t == -1) return 1;
-    /* Compute difference between local time and UTC in seconds.
-       Be careful, since time_t might be unsigned. */
-
-    tdiff = (int) difftime(loc_t, utc_t);
-    if (isdst_tmp) tdiff += 60*60;
-    if (mins) *mins = (int)(tdiff / 60);
-    if (isdst) *isdst = isdst_tmp;
+    (void) TzLocalToUTC(NULL, jul * MINUTES_PER_DAY + tim, mins, isdst);
     return 0;
 }
 
@@ -1330,11 +1584,13 @@ void LocalToUTC(int locdate, int loctime, int *utcdate, int *utctime)
 void UTCToLocal(int utcdate, int utctime, int *locdate, int *loctime)
 {
     int diff;
-    int dummy;
 
-    /* Hack -- not quite right when DST changes.  */
-    if (!CalculateUTC || CalcMinsFromUTC(utcdate, utctime, &diff, &dummy))
-	diff=MinsFromUTC;
+    if (CalculateUTC) {
+	(void) TzUTCToLocal(NULL, utcdate * MINUTES_PER_DAY + utctime,
+			    &diff, NULL);
+    } else {
+	diff = MinsFromUTC;
+    }
 
     utctime += diff;
     if (utctime < 0) {
@@ -1399,6 +1655,8 @@ ClearLastTriggers(void)
     LastTrigger.once = NO_ONCE;
     LastTrigger.scanfrom = NO_DATE;
     LastTrigger.from = NO_DATE;
+    LastTrigger.scantype = SCAN_TODAY;
+    LastTrigger.scanback = 0;
     LastTrigger.priority = DefaultPrio;
     LastTrigger.sched[0] = 0;
     LastTrigger.warn[0] = 0;
@@ -13,6 +13,8 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 
 #include <stdlib.h>
 #include "types.h"
@@ -21,12 +23,23 @@
 #include "err.h"
 #include "expr.h"
 
-static int BexistsIntArray (int array[], int num, int key);
-static void InsertIntoSortedArray (int *array, int num, int key);
+#define OMIT_WORD_BITS ((int) (sizeof(unsigned int) * CHAR_BIT))
 
-/* Arrays for the global omits */
-static int FullOmitArray[MAX_FULL_OMITS];
-static int PartialOmitArray[MAX_PARTIAL_OMITS];
+static int FullOmitted (int jul);
+static int DayOmitted (int jul, int localomit);
+static int OmitFuncActive (char const *omitfunc);
+static unsigned int OmittedWord (int jul, int localomit);
+static int SetFullOmit (int jul);
+static int SetBit (unsigned int **bits, int *words, int n);
+static struct omitcontext *SaveOmitContext (void);
+static int SameOmitContext (struct omitcontext const *c);
+
+/* Bitsets for the global omits.  Full omits are indexed by Julian
+   date and grow as needed; partial omits have one word per month
+   with bit d set if day d of that month is omitted. */
+static unsigned int *FullOmitBits = NULL;
+static int FullOmitWords = 0;
+static unsigned int PartialOmitBits[12];
 
 /* How many of each omit types do we have? */
 static int NumFullOmits, NumPartialOmits;
@@ -34,14 +47,46 @@ static int NumFullOmits, NumPartialOmits;
 /* The structure for saving and restoring OMIT contexts */
 typedef struct omitcontext {
     struct omitcontext *next;
+    int id;                     /* Its number, for OmitContextId() */
     int numfull, numpart;
-    int *fullsave;
-    int *partsave;
+    int numwords;
+    unsigned int *fullsave;
+    unsigned int partsave[12];
 } OmitContext;
 
 /* The stack of saved omit contexts */
 static OmitContext *SavedOmitContexts = NULL;
 
+/* The distinct contexts numbered by OmitContextId() since the last
+   ResetOmitContextIds().  OmitVersion changes whenever the global OMITs
+   do, so the number found for the current context stays good until
+   then.  Numbers are never handed out twice, so anything remembered
+   against an old number simply stops matching after a reset. */
+#define MAX_KNOWN_OMIT_CONTEXTS 16
+static OmitContext *KnownOmitContexts = NULL;
+static int NumKnownOmitContexts = 0;
+static int NextOmitContextId = 0;
+static unsigned int OmitVersion = 0;
+static unsigned int CurrentIdVersion = 0;
+static int CurrentId = -1;
+
+/* Remembered OMITFUNC results, one entry per function.  A date's
+   bit in "known" is set once its result has been stored in the
+   corresponding bit of "omitted". */
+typedef struct omitfunccache {
+    struct omitfunccache *next;
+    char name[VAR_NAME_LEN+1];
+    unsigned int *known;
+    unsigned int *omitted;
+    int knownwords, omittedwords;
+} OmitFuncCache;
+
+static OmitFuncCache *OmitFuncCaches = NULL;
+
+static OmitFuncCache *FindOmitFuncCache (char const *name);
+static int OmitFuncLookup (char const *omitfunc, int jul, int *omit);
+static void OmitFuncStore (char const *omitfunc, int jul, int omit);
+
 /***************************************************************/
 /*                                                             */
 /*  ClearGlobalOmits                                           */
@@ -51,7 +96,13 @@ static OmitContext *SavedOmitContexts = NULL;
 /***************************************************************/
 int ClearGlobalOmits(void)
 {
+    if (FullOmitWords) {
+	memset(FullOmitBits, 0, FullOmitWords * sizeof(unsigned int));
+    }
+    memset(PartialOmitBits, 0, sizeof(PartialOmitBits));
     NumFullOmits = NumPartialOmits = 0;
+    OmitVersion++;
+    ClearOmitFuncCache();
     return OK;
 }
 
@@ -86,7 +137,6 @@ int DestroyOmitContexts(void)
     while (c) {
 	num++;
 	if (c->fullsave) free(c->fullsave);
-	if (c->partsave) free(c->partsave);
 	d = c->next;
 	free(c);
 	c = d;
@@ -104,38 +154,134 @@ int DestroyOmitContexts(void)
 /***************************************************************/
 int PushOmitContext(ParsePtr p)
 {
-    register int i;
+    OmitContext *context = SaveOmitContext();
+
+    if (!context) return E_NO_MEM;
+
+/* Add the context to the stack */
+    context->next = SavedOmitContexts;
+    SavedOmitContexts = context;
+    return VerifyEoln(p);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SaveOmitContext                                            */
+/*                                                             */
+/*  Return a copy of the current OMIT context, or NULL if we   */
+/*  run out of memory.                                         */
+/*                                                             */
+/***************************************************************/
+static OmitContext *SaveOmitContext(void)
+{
+    int words;
     OmitContext *context;
 
 /* Create the saved context */
     context = NEW(OmitContext);
-    if (!context) return E_NO_MEM;
+    if (!context) return NULL;
+
+/* Only save the words up to the last one with a bit set */
+    words = FullOmitWords;
+    if (!NumFullOmits) words = 0;
+    while (words && !FullOmitBits[words-1]) words--;
 
+    context->next = NULL;
+    context->id = -1;
     context->numfull = NumFullOmits;
     context->numpart = NumPartialOmits;
-    context->fullsave = malloc(NumFullOmits * sizeof(int));
-    if (NumFullOmits && !context->fullsave) {
-	free(context);
-	return E_NO_MEM;
+    context->numwords = words;
+    context->fullsave = NULL;
+    if (words) {
+	context->fullsave = malloc(words * sizeof(unsigned int));
+	if (!context->fullsave) {
+	    free(context);
+	    return NULL;
+	}
+	memcpy(context->fullsave, FullOmitBits, words * sizeof(unsigned int));
+    }
+    memcpy(context->partsave, PartialOmitBits, sizeof(PartialOmitBits));
+    return context;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SameOmitContext                                            */
+/*                                                             */
+/*  Return 1 if the current OMIT context is the same as the    */
+/*  saved context c, 0 otherwise.  Since the counts are exact, */
+/*  equal counts and equal saved words mean that no bits are   */
+/*  set beyond them.                                           */
+/*                                                             */
+/***************************************************************/
+static int SameOmitContext(OmitContext const *c)
+{
+    if (c->numfull != NumFullOmits || c->numpart != NumPartialOmits) {
+	return 0;
     }
-    context->partsave = malloc(NumPartialOmits * sizeof(int));
-    if (NumPartialOmits && !context->partsave) {
-	free(context->fullsave);
-	free(context);
-	return E_NO_MEM;
+    if (memcmp(c->partsave, PartialOmitBits, sizeof(PartialOmitBits))) {
+	return 0;
     }
+    return !c->numwords ||
+	!memcmp(c->fullsave, FullOmitBits, c->numwords * sizeof(unsigned int));
+}
 
-/* Copy the context over */
-    for (i=0; i<NumFullOmits; i++)
-	*(context->fullsave + i) = FullOmitArray[i];
+/***************************************************************/
+/*                                                             */
+/*  OmitContextId                                              */
+/*                                                             */
+/*  Return a small number identifying the current OMIT         */
+/*  context: the same number whenever the global OMITs are the */
+/*  same.  Returns -1 if there have been too many different    */
+/*  contexts to keep track of.                                 */
+/*                                                             */
+/***************************************************************/
+int OmitContextId(void)
+{
+    OmitContext *c;
 
-    for (i=0; i<NumPartialOmits; i++)
-	*(context->partsave + i) = PartialOmitArray[i];
+    if (CurrentId >= 0 && CurrentIdVersion == OmitVersion) {
+	return CurrentId;
+    }
+    for (c = KnownOmitContexts; c; c = c->next) {
+	if (SameOmitContext(c)) break;
+    }
+    if (!c && NumKnownOmitContexts < MAX_KNOWN_OMIT_CONTEXTS) {
+	c = SaveOmitContext();
+	if (c) {
+	    c->id = NextOmitContextId++;
+	    NumKnownOmitContexts++;
+	    c->next = KnownOmitContexts;
+	    KnownOmitContexts = c;
+	}
+    }
+    CurrentId = c ? c->id : -1;
+    CurrentIdVersion = OmitVersion;
+    return CurrentId;
+}
 
-/* Add the context to the stack */
-    context->next = SavedOmitContexts;
-    SavedOmitContexts = context;
-    return VerifyEoln(p);
+/***************************************************************/
+/*                                                             */
+/*  ResetOmitContextIds                                        */
+/*                                                             */
+/*  Forget the contexts numbered by OmitContextId() so that    */
+/*  the next calendar window starts with room for new ones.    */
+/*                                                             */
+/***************************************************************/
+void ResetOmitContextIds(void)
+{
+    OmitContext *c = KnownOmitContexts;
+    OmitContext *d;
+
+    while (c) {
+	if (c->fullsave) free(c->fullsave);
+	d = c->next;
+	free(c);
+	c = d;
+    }
+    KnownOmitContexts = NULL;
+    NumKnownOmitContexts = 0;
+    CurrentId = -1;
 }
 
 /***************************************************************/
@@ -147,26 +293,29 @@ int PushOmitContext(ParsePtr p)
 /***************************************************************/
 int PopOmitContext(ParsePtr p)
 {
-
-    register int i;
     OmitContext *c = SavedOmitContexts;
 
     if (!c) return E_POP_NO_PUSH;
     NumFullOmits = c->numfull;
     NumPartialOmits = c->numpart;
 
-/* Copy the context over */
-    for (i=0; i<NumFullOmits; i++)
-	FullOmitArray[i] = *(c->fullsave + i);
-
-    for (i=0; i<NumPartialOmits; i++)
-	PartialOmitArray[i] = *(c->partsave + i);
+/* Copy the context over.  The bitset never shrinks, so the saved
+   words always fit. */
+    if (c->numwords) {
+	memcpy(FullOmitBits, c->fullsave, c->numwords * sizeof(unsigned int));
+    }
+    if (FullOmitWords > c->numwords) {
+	memset(FullOmitBits + c->numwords, 0,
+	       (FullOmitWords - c->numwords) * sizeof(unsigned int));
+    }
+    memcpy(PartialOmitBits, c->partsave, sizeof(PartialOmitBits));
+    OmitVersion++;
+    ClearOmitFuncCache();
 
 /* Remove the context from the stack */
     SavedOmitContexts = c->next;
 
 /* Free memory used by the saved context */
-    if (c->partsave) free(c->partsave);
     if (c->fullsave) free(c->fullsave);
     free(c);
 
@@ -187,88 +336,436 @@ int IsOmitted(int jul, int localomit, char const *omitfunc, int *omit)
 
     /* If we have an omitfunc, we *only* use it and ignore local/global
        OMITs */
-    if (omitfunc && *omitfunc && UserFuncExists(omitfunc)) {
+    if (OmitFuncActive(omitfunc)) {
 	char expr[VAR_NAME_LEN + 32];
 	char const *s;
-	int r;
+	int r, dep;
 	Value v;
 
+	if (OmitFuncLookup(omitfunc, jul, omit)) return OK;
+
 	FromJulian(jul, &y, &m, &d);
 	sprintf(expr, "%s('%04d-%02d-%02d')",
 		omitfunc, y, m+1, d);
 	s = expr;
+	dep = DateDependent;
+	DateDependent = 0;
 	r = EvalExpr(&s, &v, NULL);
-	if (r) return r;
+	if (r) {
+	    DateDependent |= dep;
+	    return r;
+	}
 	if (v.type == INT_TYPE && v.v.val != 0) {
 	    *omit = 1;
 	} else {
 	    *omit = 0;
 	}
+	DestroyValue(v);
+
+	/* Only remember results that don't depend on today's date
+	   or on trigger state */
+	if (!DateDependent) OmitFuncStore(omitfunc, jul, *omit);
+	DateDependent |= dep;
 	return OK;
     }
 
+    *omit = DayOmitted(jul, localomit);
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OmitFuncActive                                             */
+/*                                                             */
+/*  Return 1 if omitfunc names a function that IsOmitted()     */
+/*  would call instead of looking at the OMITs.                */
+/*                                                             */
+/***************************************************************/
+static int OmitFuncActive(char const *omitfunc)
+{
+    return omitfunc && *omitfunc && UserFuncExists(omitfunc);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DayOmitted                                                 */
+/*                                                             */
+/*  Return 1 if jul is omitted by the weekdays in localomit or */
+/*  by the global OMITs, 0 otherwise.                          */
+/*                                                             */
+/***************************************************************/
+static int DayOmitted(int jul, int localomit)
+{
+    int y, m, d;
+
     /* Is it omitted because of local omits? */
-    if (localomit & (1 << (jul % 7))) {
-	*omit = 1;
-	return OK;
-    }
+    if (localomit & (1 << (jul % 7))) return 1;
 
     /* Is it omitted because of fully-specified omits? */
-    if (BexistsIntArray(FullOmitArray, NumFullOmits, jul)) {
-	*omit = 1;
+    if (NumFullOmits && FullOmitted(jul)) return 1;
+
+    if (NumPartialOmits) {
+	FromJulian(jul, &y, &m, &d);
+	if (PartialOmitBits[m] & (1U << d)) return 1;
+    }
+
+    /* Not omitted */
+    return 0;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OmittedWord                                                */
+/*                                                             */
+/*  Return a word whose bit i is set if jul+i is omitted by    */
+/*  the weekdays in localomit or by the global OMITs, so that  */
+/*  whole runs of days can be examined at once.                */
+/*                                                             */
+/***************************************************************/
+static unsigned int OmittedWord(int jul, int localomit)
+{
+    unsigned int w = 0;
+    unsigned int bits;
+    int i, n, y, m, d, word, shift;
+
+    /* Days before the start of time are never omitted */
+    if (jul < 0) {
+	for (i=-jul; i<OMIT_WORD_BITS; i++) {
+	    if (DayOmitted(jul+i, localomit)) w |= 1U << i;
+	}
+	return w;
+    }
+
+    /* Local omits repeat every week */
+    if (localomit) {
+	bits = ((localomit | (localomit << 7)) >> (jul % 7)) & 0x7F;
+	for (i=0; i<OMIT_WORD_BITS; i+=7) w |= bits << i;
+    }
+
+    /* Fully-specified omits straddle at most two words */
+    if (NumFullOmits) {
+	word = jul / OMIT_WORD_BITS;
+	shift = jul % OMIT_WORD_BITS;
+	if (word < FullOmitWords) {
+	    w |= FullOmitBits[word] >> shift;
+	    if (shift && word+1 < FullOmitWords) {
+		w |= FullOmitBits[word+1] << (OMIT_WORD_BITS - shift);
+	    }
+	}
+    }
+
+    /* Partial omits, a month at a time */
+    if (NumPartialOmits) {
+	FromJulian(jul, &y, &m, &d);
+	for (i=0; i<OMIT_WORD_BITS; i+=n) {
+	    n = DaysInMonth(m, y) - d + 1;
+	    bits = PartialOmitBits[m] >> d;
+	    if (n < OMIT_WORD_BITS) bits &= (1U << n) - 1;
+	    w |= bits << i;
+	    d = 1;
+	    if (++m == 12) {
+		m = 0;
+		y++;
+	    }
+	}
+    }
+    return w;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OmitRun                                                    */
+/*                                                             */
+/*  Set *count to the number of consecutive omitted days       */
+/*  starting at jul and going forward (dir = 1) or backward    */
+/*  (dir = -1), but to no more than limit.  Without an         */
+/*  OMITFUNC, a word of days is examined at a time.  Returns   */
+/*  OK or an error from the OMITFUNC.                          */
+/*                                                             */
+/***************************************************************/
+int OmitRun(int jul, int dir, int localomit, char const *omitfunc, int limit, int *count)
+{
+    unsigned int w;
+    int n = 0;
+    int r, omit;
+
+    if (OmitFuncActive(omitfunc)) {
+	while (n < limit) {
+	    r = IsOmitted(jul + dir*n, localomit, omitfunc, &omit);
+	    if (r) return r;
+	    if (!omit) break;
+	    n++;
+	}
+	*count = n;
 	return OK;
     }
 
-    FromJulian(jul, &y, &m, &d);
-    if (BexistsIntArray(PartialOmitArray, NumPartialOmits, (m << 5) + d)) {
-	*omit = 1;
+    while (n < limit) {
+	if (dir > 0) {
+	    w = ~OmittedWord(jul + n, localomit);
+	    if (w) {
+		n += LowestBit(w);
+		break;
+	    }
+	} else {
+	    w = ~OmittedWord(jul - n - (OMIT_WORD_BITS-1), localomit);
+	    if (w) {
+		n += OMIT_WORD_BITS - 1 - HighestBit(w);
+		break;
+	    }
+	}
+	n += OMIT_WORD_BITS;
+    }
+    *count = (n < limit) ? n : limit;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  NonOmittedSteps                                            */
+/*                                                             */
+/*  Examine the days starting at jul and going forward (dir =  */
+/*  1) or backward (dir = -1) until n days that aren't omitted */
+/*  have been seen, and set *steps to the number of days       */
+/*  examined.  Give up after limit days, setting *steps to     */
+/*  limit+1.  Returns OK or an error from the OMITFUNC.        */
+/*                                                             */
+/***************************************************************/
+int NonOmittedSteps(int jul, int dir, int n, int localomit, char const *omitfunc, int limit, int *steps)
+{
+    unsigned int w;
+    int done = 0;
+    int r, omit, c;
+
+    if (n <= 0) {
+	*steps = 0;
+	return OK;
+    }
+    if (OmitFuncActive(omitfunc)) {
+	while (done < limit) {
+	    r = IsOmitted(jul + dir*done, localomit, omitfunc, &omit);
+	    if (r) return r;
+	    done++;
+	    if (!omit && !--n) {
+		*steps = done;
+		return OK;
+	    }
+	}
+	*steps = limit+1;
 	return OK;
     }
 
-    /* Not omitted */
-    *omit = 0;
+    while (done < limit) {
+	if (dir > 0) {
+	    w = ~OmittedWord(jul + done, localomit);
+	} else {
+	    w = ~OmittedWord(jul - done - (OMIT_WORD_BITS-1), localomit);
+	}
+	c = CountBits(w);
+	if (c >= n) {
+	    /* The one we want is in this word */
+	    if (dir > 0) {
+		while (--n) w &= w - 1;
+		done += LowestBit(w) + 1;
+	    } else {
+		while (--n) w &= ~(1U << HighestBit(w));
+		done += OMIT_WORD_BITS - HighestBit(w);
+	    }
+	    *steps = (done <= limit) ? done : limit+1;
+	    return OK;
+	}
+	n -= c;
+	done += OMIT_WORD_BITS;
+    }
+    *steps = limit+1;
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  CountNonOmitted                                            */
+/*                                                             */
+/*  Return the number of days from start up to but not         */
+/*  including end that are not omitted by the weekdays in     */
+/*  localomit or by the global OMITs.                          */
+/*                                                             */
+/***************************************************************/
+int CountNonOmitted(int start, int end, int localomit)
+{
+    unsigned int w;
+    int n = 0;
+    int left;
+
+    while (start < end) {
+	w = ~OmittedWord(start, localomit);
+	left = end - start;
+	if (left < OMIT_WORD_BITS) w &= (1U << left) - 1;
+	n += CountBits(w);
+	start += OMIT_WORD_BITS;
+    }
+    return n;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FullOmitted                                                */
+/*                                                             */
+/*  Return 1 if jul is a fully-specified global OMIT, 0        */
+/*  otherwise.                                                 */
+/*                                                             */
+/***************************************************************/
+static int FullOmitted(int jul)
+{
+    int w;
+
+    if (jul < 0) return 0;
+    w = jul / OMIT_WORD_BITS;
+    if (w >= FullOmitWords) return 0;
+    return (FullOmitBits[w] >> (jul % OMIT_WORD_BITS)) & 1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetFullOmit                                                */
+/*                                                             */
+/*  Add jul to the fully-specified global OMITs, growing the   */
+/*  bitset if necessary.  A date before the start of the       */
+/*  calendar, as ADDOMIT gives for an expired trigger, can     */
+/*  never be omitted and is quietly ignored.                   */
+/*                                                             */
+/***************************************************************/
+static int SetFullOmit(int jul)
+{
+    int r;
+
+    if (jul < 0) return OK;
+    if (FullOmitted(jul)) return OK;
+    r = SetBit(&FullOmitBits, &FullOmitWords, jul);
+    if (r) return r;
+    NumFullOmits++;
+    OmitVersion++;
+    ClearOmitFuncCache();
+    return OK;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SetBit                                                     */
+/*                                                             */
+/*  Set bit n in a growable bitset of *words words, enlarging  */
+/*  it if necessary.                                           */
+/*                                                             */
+/***************************************************************/
+static int SetBit(unsigned int **bits, int *words, int n)
+{
+    int w = n / OMIT_WORD_BITS;
+    int size;
+    unsigned int *b;
+
+    if (w >= *words) {
+	size = *words ? *words : 64;
+	while (size <= w) size *= 2;
+	b = realloc(*bits, size * sizeof(unsigned int));
+	if (!b) return E_NO_MEM;
+	memset(b + *words, 0, (size - *words) * sizeof(unsigned int));
+	*bits = b;
+	*words = size;
+    }
+    (*bits)[w] |= 1U << (n % OMIT_WORD_BITS);
     return OK;
 }
 
 /***************************************************************/
 /*                                                             */
-/*  BexistsIntArray                                            */
+/*  ClearOmitFuncCache                                         */
 /*                                                             */
-/*  Perform a binary search on an integer array.  Return 1 if  */
-/*  element is found, 0 otherwise.                             */
+/*  Forget all remembered OMITFUNC results.  Called whenever   */
+/*  something an OMITFUNC might consult changes: variables,    */
+/*  user-defined functions or the global OMITs.                */
 /*                                                             */
 /***************************************************************/
-static int BexistsIntArray(int array[], int num, int key)
+void ClearOmitFuncCache(void)
 {
-    int top=num-1, bot=0, mid;
+    OmitFuncCache *c = OmitFuncCaches;
+    OmitFuncCache *next;
 
-    while (top >= bot) {
-	mid = (top+bot)/2;
-	if (array[mid] == key) return 1;
-	else if (array[mid] > key) top = mid-1;
-	else bot=mid+1;
+    while (c) {
+	next = c->next;
+	if (c->known) free(c->known);
+	if (c->omitted) free(c->omitted);
+	free(c);
+	c = next;
     }
-    return 0;
+    OmitFuncCaches = NULL;
 }
 
 /***************************************************************/
 /*                                                             */
-/*  InsertIntoSortedArray                                      */
+/*  FindOmitFuncCache                                          */
 /*                                                             */
-/*  Insert a key into a sorted array.  We assume that there is */
-/*  room in the array for it.                                  */
+/*  Find the cache entry for the named OMITFUNC, or NULL.      */
 /*                                                             */
 /***************************************************************/
-static void InsertIntoSortedArray(int *array, int num, int key)
+static OmitFuncCache *FindOmitFuncCache(char const *name)
 {
-    /* num is number of elements CURRENTLY in the array. */
-    int *cur = array+num;
+    OmitFuncCache *c = OmitFuncCaches;
+
+    while (c && StrinCmp(name, c->name, VAR_NAME_LEN)) c = c->next;
+    return c;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OmitFuncLookup                                             */
+/*                                                             */
+/*  If we remember the result of omitfunc for jul, store it in */
+/*  *omit and return 1.  Otherwise, return 0.                  */
+/*                                                             */
+/***************************************************************/
+static int OmitFuncLookup(char const *omitfunc, int jul, int *omit)
+{
+    OmitFuncCache *c;
+    int w;
+
+    /* Evaluate every time when tracing so the trace is complete */
+    if (DebugFlag & DB_PRTEXPR) return 0;
+    if (jul < 0) return 0;
+
+    c = FindOmitFuncCache(omitfunc);
+    if (!c) return 0;
+    w = jul / OMIT_WORD_BITS;
+    if (w >= c->knownwords ||
+	!((c->known[w] >> (jul % OMIT_WORD_BITS)) & 1)) return 0;
+    *omit = (w < c->omittedwords) &&
+	((c->omitted[w] >> (jul % OMIT_WORD_BITS)) & 1);
+    return 1;
+}
 
-    while (cur > array && *(cur-1) > key) {
-	*cur = *(cur-1);
-	cur--;
+/***************************************************************/
+/*                                                             */
+/*  OmitFuncStore                                              */
+/*                                                             */
+/*  Remember the result of omitfunc for jul.  Failure to       */
+/*  allocate memory just means the result is not remembered.   */
+/*                                                             */
+/***************************************************************/
+static void OmitFuncStore(char const *omitfunc, int jul, int omit)
+{
+    OmitFuncCache *c;
+
+    if (jul < 0) return;
+    c = FindOmitFuncCache(omitfunc);
+    if (!c) {
+	c = NEW(OmitFuncCache);
+	if (!c) return;
+	StrnCpy(c->name, omitfunc, VAR_NAME_LEN);
+	c->known = c->omitted = NULL;
+	c->knownwords = c->omittedwords = 0;
+	c->next = OmitFuncCaches;
+	OmitFuncCaches = c;
     }
-    *cur = key;
+    if (omit && SetBit(&c->omitted, &c->omittedwords, jul)) return;
+    (void) SetBit(&c->known, &c->knownwords, jul);
 }
 
 static int DoThroughOmit(ParsePtr p, int y, int m, int d);
@@ -286,7 +783,6 @@ int DoOmit(ParsePtr p)
     int y = NO_YR, m = NO_MON, d = NO_DAY, r;
     Token tok;
     int parsing=1;
-    int syndrome;
     int not_first_token = -1;
 
     DynamicBuffer buf;
@@ -361,19 +857,17 @@ int DoOmit(ParsePtr p)
     if (m == NO_MON || d == NO_DAY) return E_SPEC_MON_DAY;
 
     if (y == NO_YR) {
-	if (NumPartialOmits == MAX_PARTIAL_OMITS) return E_2MANY_PART;
-
 	if (d > MonthDays[m]) return E_BAD_DATE;
-	syndrome = (m<<5) + d;
-	if (!BexistsIntArray(PartialOmitArray, NumPartialOmits, syndrome)) {
-	    InsertIntoSortedArray(PartialOmitArray, NumPartialOmits, syndrome);
+	if (!(PartialOmitBits[m] & (1U << d))) {
+	    PartialOmitBits[m] |= (1U << d);
 	    NumPartialOmits++;
+	    OmitVersion++;
+	    ClearOmitFuncCache();
 	}
     } else {
 
 	if (d > DaysInMonth(m, y)) return E_BAD_DATE;
-	syndrome = Julian(y, m, d);
-        r = AddGlobalOmit(syndrome);
+        r = AddGlobalOmit(Julian(y, m, d));
         if (r) {
             return r;
         }
@@ -386,12 +880,7 @@ int DoOmit(ParsePtr p)
 int
 AddGlobalOmit(int jul)
 {
-    if (NumFullOmits == MAX_FULL_OMITS) return E_2MANY_FULL;
-    if (!BexistsIntArray(FullOmitArray, NumFullOmits, jul)) {
-        InsertIntoSortedArray(FullOmitArray, NumFullOmits, jul);
-        NumFullOmits++;
-    }
-    return OK;
+    return SetFullOmit(jul);
 }
 
 static int
@@ -469,15 +958,9 @@ DoThroughOmit(ParsePtr p, int ystart, int mstart, int dstart)
 	end = tmp;
     }
 
-    tmp = end - start + 1;
-
-    /* Don't create any OMITs if there would be too many. */
-    if (NumFullOmits + tmp >= MAX_FULL_OMITS) return E_2MANY_FULL;
     for (tmp = start; tmp <= end; tmp++) {
-	if (!BexistsIntArray(FullOmitArray, NumFullOmits, tmp)) {
-	    InsertIntoSortedArray(FullOmitArray, NumFullOmits, tmp);
-	    NumFullOmits++;
-	}
+	r = SetFullOmit(tmp);
+	if (r) return r;
     }
     if (tok.type == T_Tag || tok.type == T_Duration || tok.type == T_RemType || tok.type == T_Priority) return E_PARSE_AS_REM;
     return OK;
@@ -486,27 +969,33 @@ DoThroughOmit(ParsePtr p, int ystart, int mstart, int dstart)
 void
 DumpOmits(void)
 {
-    int i;
+    int w, b;
     int y, m, d;
-    printf("Global Full OMITs (%d of maximum allowed %d):\n", NumFullOmits, MAX_FULL_OMITS);
+    unsigned int bits;
+    printf("Global Full OMITs (%d):\n", NumFullOmits);
     if (!NumFullOmits) {
 	printf("\tNone.\n");
     } else {
-	for (i=0; i<NumFullOmits; i++) {
-	    FromJulian(FullOmitArray[i], &y, &m, &d);
-	    printf("\t%04d%c%02d%c%02d\n",
-		    y, DateSep, m+1, DateSep, d);
+	for (w=0; w<FullOmitWords; w++) {
+	    bits = FullOmitBits[w];
+	    for (b=0; bits; b++, bits >>= 1) {
+		if (!(bits & 1)) continue;
+		FromJulian(w * OMIT_WORD_BITS + b, &y, &m, &d);
+		printf("\t%04d%c%02d%c%02d\n",
+		       y, DateSep, m+1, DateSep, d);
+	    }
 	}
     }
-    printf("Global Partial OMITs (%d of maximum allowed %d):\n", NumPartialOmits, MAX_PARTIAL_OMITS);
+    printf("Global Partial OMITs (%d):\n", NumPartialOmits);
     if (!NumPartialOmits) {
 	printf("\tNone.\n");
     } else {
-	for (i=0; i<NumPartialOmits; i++) {
-	    m = PartialOmitArray[i] >> 5 & 0xf;
-	    d = PartialOmitArray[i] & 0x1f;
-	    printf("\t%02d%c%02d\n", m+1, DateSep, d);
+	for (m=0; m<12; m++) {
+	    for (d=1; d<=31; d++) {
+		if (PartialOmitBits[m] & (1U << d)) {
+		    printf("\t%02d%c%02d\n", m+1, DateSep, d);
+		}
+	    }
 	}
     }
 }
-
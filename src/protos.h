@@ -26,6 +26,7 @@
 int CallUserFunc (char const *name, int nargs, ParsePtr p);
 int DoFset (ParsePtr p);
 void ProduceCalendar (void);
+void FreeCalMemo (CalMemo *m);
 char const *SimpleTime (int tim);
 char const *CalendarTime (int tim, int duration);
 int DoRem (ParsePtr p);
@@ -39,6 +40,7 @@ int DoSubstFromString (char const *source, DynamicBuffer *dbuf, int jul, int tim
 int ParseLiteralDate (char const **s, int *jul, int *tim);
 int ParseLiteralTime (char const **s, int *tim);
 int EvalExpr (char const **e, Value *v, ParsePtr p);
+int EvalCompiledExpr (CompiledExpr *c, char const **e, Value *v, ParsePtr p);
 int DoCoerce (char type, Value *v);
 void PrintValue  (Value *v, FILE *fp);
 int CopyValue (Value *dest, const Value *src);
@@ -50,16 +52,30 @@ int IncludeFile (char const *fname);
 int GetAccessDate (char const *file);
 int SetAccessDate (char const *fname, int jul);
 int TopLevel (void);
+CompiledExpr *CachedExpr (char const *s);
+CalMemo **CachedLineMemo (void);
+int RefreshFileCache (int commands);
+int PreloadFile (char const *fname);
+void RecheckCachedFiles (void);
+int WatchCachedFiles (int fd);
+int GetCacheDir (char const *sub, DynamicBuffer *dbuf);
 int CallFunc (BuiltinFunc *f, int nargs);
 void InitRemind (int argc, char const *argv[]);
+void ResetInterpreter (void);
 void Usage (void);
 int Julian (int year, int month, int day);
 void FromJulian (int jul, int *y, int *m, int *d);
+void FromJulianArray (int const *jul, int n, int *y, int *m, int *d);
 int ParseChar (ParsePtr p, int *err, int peek);
 int ParseToken (ParsePtr p, DynamicBuffer *dbuf);
 int ParseIdentifier (ParsePtr p, DynamicBuffer *dbuf);
 int EvaluateExpr (ParsePtr p, Value *v);
 int Evaluate (char const **s, Var *locals, ParsePtr p);
+CompiledExpr *CompileExpr (char const *s, Var *locals);
+void FreeCompiledExpr (CompiledExpr *c);
+int CompiledExprStale (CompiledExpr const *c);
+int CompiledExprSelfContained (CompiledExpr const *c);
+int EvaluateCompiled (CompiledExpr *c, char const **s, Var *locals, ParsePtr p);
 int FnPopValStack (Value *val);
 void Eprint (char const *fmt, ...);
 void Wprint (char const *fmt, ...);
@@ -85,6 +101,13 @@ int DestroyOmitContexts (void);
 int PushOmitContext (ParsePtr p);
 int PopOmitContext (ParsePtr p);
 int IsOmitted (int jul, int localomit, char const *omitfunc, int *omit);
+void ClearOmitFuncCache (void);
+int OmitContextId (void);
+void ResetOmitContextIds (void);
+int OmitRun (int jul, int dir, int localomit, char const *omitfunc, int limit, int *count);
+int NonOmittedSteps (int jul, int dir, int n, int localomit, char const *omitfunc, int limit, int *steps);
+int CountNonOmitted (int start, int end, int localomit);
+void ClearShellCache (void);
 int DoOmit (ParsePtr p);
 int QueueReminder (ParsePtr p, Trigger *trig, TimeTrig *tim, char const *sched);
 void HandleQueuedReminders (void);
@@ -95,6 +118,8 @@ int ComputeTrigger (int today, Trigger *trig, TimeTrig *tim, int *err, int save_
 int ComputeTriggerNoAdjustDuration (int today, Trigger *trig, TimeTrig *tim, int *err, int save_in_globals, int duration_days);
 int AdjustTriggerForDuration(int today, int r, Trigger *trig, TimeTrig *tim, int save_in_globals);
 int ComputeScanStart(int today, Trigger *trig, TimeTrig *tt);
+int TriggerScanStart(Trigger const *trig, int today);
+int EnumerateTriggers(Trigger const *trig, TimeTrig const *tim, int start, int end, int save_in_globals, TrigFunc fn, void *data);
 char *StrnCpy (char *dest, char const *source, int n);
 int StrMatch (char const *s1, char const *s2, int n);
 int StrinCmp (char const *s1, char const *s2, int n);
@@ -110,17 +135,23 @@ int DoDump (ParsePtr p);
 void DumpVarTable (void);
 void DestroyVars (int all);
 int PreserveVar (char const *name);
+void SaveSysVars (void);
+void RestoreSysVars (void);
 int DoPreserve  (Parser *p);
-int DoSatRemind (Trigger *trig, TimeTrig *tt, ParsePtr p);
+int DoSatRemind (Trigger *trig, TimeTrig *tt, ParsePtr p, SatMemo *memo);
 int DoMsgCommand (char const *cmd, char const *msg);
 int ParseNonSpaceChar (ParsePtr p, int *err, int peek);
 unsigned int HashVal (char const *str);
 int DateOK (int y, int m, int d);
+int LowestBit (unsigned int x);
+int HighestBit (unsigned int x);
+int CountBits (unsigned int x);
 Operator *FindOperator (char const *name, Operator where[], int num);
 BuiltinFunc *FindFunc (char const *name, BuiltinFunc where[], int num);
 int InsertIntoSortBuffer (int jul, int tim, char const *body, int typ, int prio);
 void IssueSortedReminders (void);
 int UserFuncExists (char const *fn);
+void DestroyUserFuncs (void);
 void JulToHeb (int jul, int *hy, int *hm, int *hd);
 int HebNameToNum (char const *mname);
 char const *HebMonthName (int m, int y);
@@ -139,6 +170,9 @@ int CalcMinsFromUTC (int jul, int tim, int *mins, int *isdst);
 void FillParagraph (char const *s);
 void LocalToUTC (int locdate, int loctime, int *utcdate, int *utctime);
 void UTCToLocal (int utcdate, int utctime, int *locdate, int *loctime);
+int TzLocalToUTC (char const *zone, int local, int *mins, int *isdst);
+int TzUTCToLocal (char const *zone, int utc, int *mins, int *isdst);
+void TzClearCache (void);
 int MoonPhase (int date, int time);
 void HuntPhase (int startdate, int starttim, int phas, int *date, int *time);
 int CompareRems (int dat1, int tim1, int prio1, int dat2, int tim2, int prio2, int bydate, int bytime, int byprio, int untimed_first);
@@ -154,6 +188,12 @@ void SaveLastTimeTrig(TimeTrig const *t);
 void SaveAllTriggerInfo(Trigger const *t, TimeTrig const *tt, int trigdate, int trigtime, int valid);
 
 void PerIterationInit(void);
+void ReloadReminders(void);
+void RunReminderPass(void);
+void SetToday(int jul);
+void RunServer(void);
+int RunRemind(void);
+int RunBatch(void);
 char const *Decolorize(int r, int g, int b);
 char const *Colorize(int r, int g, int b);
 void PrintJSONString(char const *s);
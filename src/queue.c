@@ -26,6 +26,19 @@
 #include <sys/select.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT1)
+#include <sys/inotify.h>
+#endif
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1) && \
+    defined(HAVE_SYS_TIMERFD_H) && defined(HAVE_TIMERFD_CREATE)
+#define USE_EPOLL 1
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
 #include "types.h"
 #include "globals.h"
@@ -39,6 +52,8 @@ typedef struct queuedrem {
     int typ;
     int RunDisabled;
     int ntrig;
+    int seq;
+    int heapidx;
     char const *text;
     char passthru[PASSTHRU_LEN+1];
     char sched[VAR_NAME_LEN+1];
@@ -53,12 +68,51 @@ static QueuedRem *QueueHead;
 static time_t FileModTime;
 static struct stat StatBuf;
 
+/* Binary min-heap of reminders still to be issued, ordered by
+   tt.nexttime.  NULL if we could not allocate it, in which case
+   we fall back to scanning the list. */
+static QueuedRem **QueueHeap;
+static int QueueHeapSize;
+
+/* Value of SortByDate before we started handling the queue */
+static int SortByDateOrig;
+
+/* Set when reread() has replaced the queue */
+static int Reloaded;
+
+/* inotify descriptor watching the files we read, or -1 if we
+   have to poll the initial file instead */
+static int FileWatch = -1;
+
+/* epoll descriptor for the event loop and the timer it waits on, or
+   -1 if we have to use the sleep()/select() loop */
+static int EventFd = -1;
+static int TimerFd = -1;
+
 static void CheckInitialFile (void);
 static int CalculateNextTime (QueuedRem *q);
 static QueuedRem *FindNextReminder (void);
+static int IssueBefore (QueuedRem const *a, QueuedRem const *b);
+static void HeapSwap (int i, int j);
+static void HeapSiftDown (int i);
+static void HeapSiftUp (int i);
+static void BuildQueueHeap (void);
+static void UpdateQueueHeap (QueuedRem *q);
+static void InitQueue (QueuedRem *old);
+static unsigned int QueueHash (QueuedRem const *q);
+static int SameReminder (QueuedRem const *a, QueuedRem const *b);
+static void FreeQueuedRem (QueuedRem *q);
+static void SetupFileWatches (void);
+static int FilesChanged (void);
+static void WaitForFileChange (unsigned int secs);
 static int CalculateNextTimeUsingSched (QueuedRem *q);
 static void DaemonWait (struct timeval *sleep_tv);
+static void DaemonCommand (void);
 static void reread (void);
+#ifdef USE_EPOLL
+static void SetupEventLoop (void);
+static void WaitForEvent (QueuedRem const *q);
+#endif
 
 /***************************************************************/
 /*                                                             */
@@ -97,6 +151,8 @@ int QueueReminder(ParsePtr p, Trigger *trig,
     qelem->next = QueueHead;
     qelem->RunDisabled = RunDisabled;
     qelem->ntrig = 0;
+    qelem->seq = NumQueued;
+    qelem->heapidx = -1;
     strcpy(qelem->sched, sched);
     DBufInit(&(qelem->tags));
     DBufPuts(&(qelem->tags), DBufValue(&(trig->tags)));
@@ -128,6 +184,7 @@ void HandleQueuedReminders(void)
     NumTriggered = 1;
 
     /* Turn off sorting -- otherwise, TriggerReminder has no effect! */
+    SortByDateOrig = SortByDate;
     SortByDate = 0;
 
     /* If we are not connected to a tty, then we must close the
@@ -154,12 +211,11 @@ void HandleQueuedReminders(void)
     }
 
     /* Initialize the queue - initialize all the entries time of issue */
-
-    while (q) {
-	q->tt.nexttime = (int) (SystemTime(1)/60 - 1);
-	q->tt.nexttime = CalculateNextTime(q);
-	q = q->next;
-    }
+    InitQueue(NULL);
+#ifdef USE_EPOLL
+    SetupEventLoop();
+#endif
+    SetupFileWatches();
 
     if (!DontFork || Daemon) signal(SIGINT, SigIntHandler);
 
@@ -170,6 +226,17 @@ void HandleQueuedReminders(void)
 	/* If no more reminders to issue, we're done unless we're a daemon. */
 	if (!q && !Daemon) break;
 
+#ifdef USE_EPOLL
+	/* Sleep until something happens, then take another look */
+	if (EventFd >= 0) {
+	    if (!q || q->tt.nexttime * 60L > SystemTime(1)) {
+		WaitForEvent(q);
+		Reloaded = 0;
+		continue;
+	    }
+	    TimeToSleep = 0;
+	} else
+#endif
 	if (Daemon && !q) {
 	    if (Daemon < 0) {
 		/* Sleep until midnight */
@@ -201,6 +268,8 @@ void HandleQueuedReminders(void)
                     sleep_tv.tv_usec = 0;
                 }
 		DaemonWait(&sleep_tv);
+	    } else if (FileWatch >= 0) {
+		WaitForFileChange(SleepTime);
 	    } else {
 		sleep(SleepTime);
             }
@@ -216,6 +285,9 @@ void HandleQueuedReminders(void)
 
 	    if (Daemon > 0 && SleepTime) CheckInitialFile();
 
+	    /* If the queue was rebuilt, q is gone; start over */
+	    if (Reloaded) break;
+
 	    if (Daemon && !q) {
 		if (Daemon < 0) {
 		    /* Sleep until midnight */
@@ -229,6 +301,11 @@ void HandleQueuedReminders(void)
 
 	}
 
+	if (Reloaded) {
+	    Reloaded = 0;
+	    continue;
+	}
+
 	/* Do NOT trigger the reminder if tt.nexttime is more than a
 	   minute in the past.  This can happen if the clock is
 	   changed or a laptop awakes from hibernation.
@@ -265,6 +342,7 @@ void HandleQueuedReminders(void)
 
 	/* Calculate the next trigger time */
 	q->tt.nexttime = CalculateNextTime(q);
+	UpdateQueueHeap(q);
     }
     exit(0);
 }
@@ -323,6 +401,10 @@ static QueuedRem *FindNextReminder(void)
     QueuedRem *q = QueueHead;
     QueuedRem *ans = NULL;
 
+    if (QueueHeap) {
+	return QueueHeapSize ? QueueHeap[0] : NULL;
+    }
+
     while (q) {
 	if (q->tt.nexttime != NO_TIME) {
 	    if (!ans) ans = q;
@@ -335,6 +417,212 @@ static QueuedRem *FindNextReminder(void)
 }
 
 
+/***************************************************************/
+/*                                                             */
+/*  IssueBefore                                                */
+/*                                                             */
+/*  Return non-zero if reminder a should be issued before b.   */
+/*  Ties go to the reminder nearer the head of the list (the   */
+/*  one queued later) so the order matches a list scan.        */
+/*                                                             */
+/***************************************************************/
+static int IssueBefore(QueuedRem const *a, QueuedRem const *b)
+{
+    if (a->tt.nexttime != b->tt.nexttime) {
+	return a->tt.nexttime < b->tt.nexttime;
+    }
+    return a->seq > b->seq;
+}
+
+static void HeapSwap(int i, int j)
+{
+    QueuedRem *tmp = QueueHeap[i];
+
+    QueueHeap[i] = QueueHeap[j];
+    QueueHeap[j] = tmp;
+    QueueHeap[i]->heapidx = i;
+    QueueHeap[j]->heapidx = j;
+}
+
+static void HeapSiftDown(int i)
+{
+    int child;
+
+    while ((child = 2*i + 1) < QueueHeapSize) {
+	if (child+1 < QueueHeapSize &&
+	    IssueBefore(QueueHeap[child+1], QueueHeap[child])) child++;
+	if (!IssueBefore(QueueHeap[child], QueueHeap[i])) break;
+	HeapSwap(i, child);
+	i = child;
+    }
+}
+
+static void HeapSiftUp(int i)
+{
+    int parent;
+
+    while (i > 0) {
+	parent = (i-1) / 2;
+	if (!IssueBefore(QueueHeap[i], QueueHeap[parent])) break;
+	HeapSwap(i, parent);
+	i = parent;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  BuildQueueHeap                                             */
+/*                                                             */
+/*  Put every reminder that still has a time to be issued      */
+/*  into the heap.                                             */
+/*                                                             */
+/***************************************************************/
+static void BuildQueueHeap(void)
+{
+    QueuedRem *q;
+    int i;
+
+    QueueHeap = malloc((NumQueued ? NumQueued : 1) * sizeof(QueuedRem *));
+    if (!QueueHeap) return;
+
+    QueueHeapSize = 0;
+    for (q = QueueHead; q; q = q->next) {
+	if (q->tt.nexttime != NO_TIME) {
+	    q->heapidx = QueueHeapSize;
+	    QueueHeap[QueueHeapSize++] = q;
+	}
+    }
+    for (i = QueueHeapSize/2 - 1; i >= 0; i--) HeapSiftDown(i);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  UpdateQueueHeap                                            */
+/*                                                             */
+/*  Restore the heap after q's nexttime has changed, removing  */
+/*  q if it has expired.                                       */
+/*                                                             */
+/***************************************************************/
+static void UpdateQueueHeap(QueuedRem *q)
+{
+    int i = q->heapidx;
+
+    if (!QueueHeap || i < 0) return;
+
+    if (q->tt.nexttime == NO_TIME) {
+	q->heapidx = -1;
+	QueueHeapSize--;
+	if (i == QueueHeapSize) return;
+	QueueHeap[i] = QueueHeap[QueueHeapSize];
+	QueueHeap[i]->heapidx = i;
+    }
+    q = QueueHeap[i];
+    HeapSiftUp(i);
+    HeapSiftDown(q->heapidx);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  InitQueue                                                  */
+/*                                                             */
+/*  Work out when each queued reminder is next to be issued    */
+/*  and build the heap.  If old is non-NULL, it is the queue   */
+/*  from before a reload: a reminder that was already there    */
+/*  keeps its trigger count and next issue time, so nothing    */
+/*  is issued twice.                                           */
+/*                                                             */
+/***************************************************************/
+static void InitQueue(QueuedRem *old)
+{
+    QueuedRem **buckets = NULL;
+    QueuedRem *q, *next, **prev;
+    int nbuckets = 0;
+    unsigned int h;
+
+    /* Hash the old queue so each new reminder can find its match.
+       The old list is rethreaded through the buckets. */
+    for (q = old; q; q = q->next) nbuckets++;
+    if (nbuckets) {
+	buckets = calloc(nbuckets, sizeof(QueuedRem *));
+    }
+    if (buckets) {
+	for (q = old; q; q = next) {
+	    next = q->next;
+	    h = QueueHash(q) % nbuckets;
+	    q->next = buckets[h];
+	    buckets[h] = q;
+	}
+    }
+
+    for (q = QueueHead; q; q = q->next) {
+	if (buckets) {
+	    prev = &buckets[QueueHash(q) % nbuckets];
+	    while (*prev && !SameReminder(*prev, q)) prev = &(*prev)->next;
+	    if (*prev) {
+		q->ntrig = (*prev)->ntrig;
+		q->tt.nexttime = (*prev)->tt.nexttime;
+		next = *prev;
+		*prev = next->next;
+		FreeQueuedRem(next);
+		continue;
+	    }
+	}
+	q->tt.nexttime = (int) (SystemTime(1)/60 - 1);
+	q->tt.nexttime = CalculateNextTime(q);
+    }
+
+    /* Get rid of whatever is left of the old queue */
+    if (buckets) {
+	for (h = 0; h < (unsigned int) nbuckets; h++) {
+	    for (q = buckets[h]; q; q = next) {
+		next = q->next;
+		FreeQueuedRem(q);
+	    }
+	}
+	free(buckets);
+    } else {
+	for (q = old; q; q = next) {
+	    next = q->next;
+	    FreeQueuedRem(q);
+	}
+    }
+
+    BuildQueueHeap();
+}
+
+static unsigned int QueueHash(QueuedRem const *q)
+{
+    return HashVal(q->text) + (unsigned int) q->tt.ttime;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  SameReminder                                               */
+/*                                                             */
+/*  Return non-zero if a and b were queued by the same         */
+/*  reminder.                                                  */
+/*                                                             */
+/***************************************************************/
+static int SameReminder(QueuedRem const *a, QueuedRem const *b)
+{
+    return a->typ == b->typ &&
+	a->RunDisabled == b->RunDisabled &&
+	a->tt.ttime == b->tt.ttime &&
+	a->tt.delta == b->tt.delta &&
+	a->tt.rep == b->tt.rep &&
+	!strcmp(a->sched, b->sched) &&
+	!strcmp(a->passthru, b->passthru) &&
+	!strcmp(a->text, b->text);
+}
+
+static void FreeQueuedRem(QueuedRem *q)
+{
+    free((char *) q->text);
+    DBufFree(&(q->tags));
+    DBufFree(&(q->t.tags));
+    free(q);
+}
+
 /***************************************************************/
 /*                                                             */
 /* GotSigInt						       */
@@ -384,7 +672,10 @@ static void CheckInitialFile(void)
     time_t tim = FileModTime;
     int y, m, d;
 
-    if (stat(InitialFile, &StatBuf) == 0) tim = StatBuf.st_mtime;
+    /* With inotify, changes are picked up as they happen */
+    if (FileWatch < 0 && stat(InitialFile, &StatBuf) == 0) {
+	tim = StatBuf.st_mtime;
+    }
     if (tim != FileModTime ||
 	RealToday != SystemDate(&y, &m, &d)) {
 	reread();
@@ -532,25 +823,50 @@ static void DaemonWait(struct timeval *sleep_tv)
     fd_set readSet;
     int retval;
     int y, m, d;
-    char cmdLine[256];
 
     FD_ZERO(&readSet);
     FD_SET(0, &readSet);
-    retval = select(1, &readSet, NULL, NULL, sleep_tv);
+    if (FileWatch >= 0) FD_SET(FileWatch, &readSet);
+    retval = select((FileWatch > 0 ? FileWatch : 0) + 1,
+		    &readSet, NULL, NULL, sleep_tv);
 
     /* If date has rolled around, restart */
     if (RealToday != SystemDate(&y, &m, &d)) {
 	printf("NOTE newdate\nNOTE reread\n");
 	fflush(stdout);
 	reread();
+	return;
     }
 
     /* If nothing readable or interrupted system call, return */
     if (retval <= 0) return;
 
+    /* If one of our files changed, reload */
+    if (FileWatch >= 0 && FD_ISSET(FileWatch, &readSet) && FilesChanged()) {
+	printf("NOTE reread\n");
+	fflush(stdout);
+	reread();
+	return;
+    }
+
     /* If stdin not readable, return */
     if (!FD_ISSET(0, &readSet)) return;
 
+    DaemonCommand();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DaemonCommand                                              */
+/*                                                             */
+/*  Read a command from stdin in "daemon -1" mode and act on   */
+/*  it.                                                        */
+/*                                                             */
+/***************************************************************/
+static void DaemonCommand(void)
+{
+    char cmdLine[256];
+
     /* If EOF on stdin, exit */
     if (feof(stdin)) {
 	exit(0);
@@ -620,11 +936,249 @@ static void DaemonWait(struct timeval *sleep_tv)
 /*                                                             */
 /*  reread                                                     */
 /*                                                             */
-/*  Restarts Remind if date rolls over or REREAD cmd received  */
+/*  Reload the reminders if the date rolls over, the initial   */
+/*  file changes or a REREAD command is received.              */
 /*                                                             */
 /***************************************************************/
 static void reread(void)
 {
-    execvp(ArgV[0], (char **) ArgV);
+    QueuedRem *old = QueueHead;
+    int olddate = JulianToday;
+
+    QueueHead = NULL;
+    NumQueued = 0;
+    if (QueueHeap) free(QueueHeap);
+    QueueHeap = NULL;
+    QueueHeapSize = 0;
+
+    /* Start the new pass the way a fresh run would */
+    SortByDate = SortByDateOrig;
+    ReloadReminders();
+    NumTriggered = 1;
+    SortByDate = 0;
+
+    if (Daemon > 0 && !stat(InitialFile, &StatBuf)) {
+	FileModTime = StatBuf.st_mtime;
+    }
+
+    /* What was issued earlier today stays issued */
+    InitQueue((JulianToday == olddate) ? old : NULL);
+    SetupFileWatches();
+    Reloaded = 1;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  SetupFileWatches                                           */
+/*                                                             */
+/*  In daemon mode, watch every file and directory read by the */
+/*  last pass so we can reload as soon as one changes.  If     */
+/*  that's not possible, FileWatch is left at -1 and we poll   */
+/*  the initial file's modification time instead.              */
+/*                                                             */
+/***************************************************************/
+static void SetupFileWatches(void)
+{
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT1)
+    if (FileWatch >= 0) close(FileWatch);
+    FileWatch = -1;
+    if (!Daemon) return;
+
+    FileWatch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (FileWatch < 0) return;
+    if (WatchCachedFiles(FileWatch) != OK) {
+	close(FileWatch);
+	FileWatch = -1;
+	return;
+    }
+#ifdef USE_EPOLL
+    if (EventFd >= 0) {
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = FileWatch;
+	if (epoll_ctl(EventFd, EPOLL_CTL_ADD, FileWatch, &ev) < 0) {
+	    close(FileWatch);
+	    FileWatch = -1;
+	}
+    }
+#endif
+#endif
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FilesChanged                                               */
+/*                                                             */
+/*  Consume pending inotify events.  Editors tend to produce a */
+/*  burst of them, so keep going until things have been quiet  */
+/*  for a moment.  Returns non-zero if there were any.         */
+/*                                                             */
+/***************************************************************/
+static int FilesChanged(void)
+{
+    char buf[4096];
+    int changed = 0;
+    ssize_t n;
+    fd_set readSet;
+    struct timeval tv;
+
+    while (1) {
+	while ((n = read(FileWatch, buf, sizeof(buf))) > 0) changed = 1;
+	if (n < 0 && errno != EAGAIN && errno != EINTR) break;
+	if (!changed) break;
+
+	FD_ZERO(&readSet);
+	FD_SET(FileWatch, &readSet);
+	tv.tv_sec = 0;
+	tv.tv_usec = 100000;
+	if (select(FileWatch+1, &readSet, NULL, NULL, &tv) <= 0) break;
+    }
+    return changed;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WaitForFileChange                                          */
+/*                                                             */
+/*  Sleep for up to secs seconds, reloading and returning      */
+/*  early if one of our files changes.                         */
+/*                                                             */
+/***************************************************************/
+static void WaitForFileChange(unsigned int secs)
+{
+    fd_set readSet;
+    struct timeval tv;
+
+    FD_ZERO(&readSet);
+    FD_SET(FileWatch, &readSet);
+    tv.tv_sec = secs;
+    tv.tv_usec = 0;
+    if (select(FileWatch+1, &readSet, NULL, NULL, &tv) > 0 &&
+	FilesChanged()) {
+	reread();
+    }
+}
+
+#ifdef USE_EPOLL
+/***************************************************************/
+/*                                                             */
+/*  SetupEventLoop                                             */
+/*                                                             */
+/*  Create the epoll descriptor and a CLOCK_REALTIME timer for */
+/*  WaitForEvent.  On failure, EventFd is left at -1 and we    */
+/*  use the sleep()/select() loop.                             */
+/*                                                             */
+/***************************************************************/
+static void SetupEventLoop(void)
+{
+    struct epoll_event ev;
+
+    EventFd = epoll_create1(EPOLL_CLOEXEC);
+    if (EventFd < 0) return;
+    TimerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (TimerFd < 0) {
+	close(EventFd);
+	EventFd = -1;
+	return;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = TimerFd;
+    if (epoll_ctl(EventFd, EPOLL_CTL_ADD, TimerFd, &ev) < 0) {
+	goto fail;
+    }
+    if (Daemon < 0) {
+	/* Read commands a byte at a time so none sit in the stdio
+	   buffer while epoll thinks stdin has nothing to offer */
+	setvbuf(stdin, NULL, _IONBF, 0);
+	ev.events = EPOLLIN;
+	ev.data.fd = 0;
+	if (epoll_ctl(EventFd, EPOLL_CTL_ADD, 0, &ev) < 0) {
+	    goto fail;
+	}
+    }
+    return;
+
+  fail:
+    close(TimerFd);
+    close(EventFd);
+    TimerFd = EventFd = -1;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WaitForEvent                                               */
+/*                                                             */
+/*  Block until q is due, the date changes, the system clock   */
+/*  is set, a daemon command arrives on stdin or one of our    */
+/*  files changes, and deal with whichever happened.  The      */
+/*  timer is absolute and cancelled when the clock is set, so  */
+/*  clock changes and suspend/resume wake us without polling.  */
+/*                                                             */
+/***************************************************************/
+static void WaitForEvent(QueuedRem const *q)
+{
+    struct itimerspec its;
+    struct epoll_event events[4];
+    long now = SystemTime(1);
+    long secs;
+    uint64_t expirations;
+    int i, n;
+    int y, m, d;
+
+    /* Wake up when q is due or at midnight, whichever is first */
+    secs = MINUTES_PER_DAY*60 - now;
+    if (q && q->tt.nexttime * 60L - now < secs) {
+	secs = q->tt.nexttime * 60L - now;
+    }
+
+    /* Without inotify, we still have to poll the initial file */
+    if (Daemon > 0 && FileWatch < 0 && secs > 60L*Daemon) {
+	secs = 60L*Daemon;
+    }
+    if (secs < 1) secs = 1;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = time(NULL) + secs;
+    if (timerfd_settime(TimerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+			&its, NULL) < 0) {
+	/* Fall back on sleeping */
+	sleep((unsigned int) secs);
+	n = 0;
+    } else {
+	n = epoll_wait(EventFd, events, 4, -1);
+    }
+
+    for (i=0; i<n; i++) {
+	if (events[i].data.fd == TimerFd) {
+	    /* Fails with ECANCELED if the clock was set; either way
+	       we just take another look at the time */
+	    (void) read(TimerFd, &expirations, sizeof(expirations));
+	} else if (events[i].data.fd == FileWatch) {
+	    if (FilesChanged()) {
+		if (Daemon < 0) {
+		    printf("NOTE reread\n");
+		    fflush(stdout);
+		}
+		reread();
+		return;
+	    }
+	} else if (events[i].data.fd == 0) {
+	    DaemonCommand();
+	    if (Reloaded) return;
+	}
+    }
+
+    /* Has the date rolled around? */
+    if (RealToday != SystemDate(&y, &m, &d)) {
+	if (!Daemon) exit(0);
+	if (Daemon < 0) {
+	    printf("NOTE newdate\nNOTE reread\n");
+	    fflush(stdout);
+	}
+	reread();
+    } else if (Daemon > 0 && FileWatch < 0) {
+	CheckInitialFile();
+    }
+}
+#endif
+
@@ -0,0 +1,351 @@
+/***************************************************************/
+/*                                                             */
+/*  SERVER.C                                                   */
+/*                                                             */
+/*  Answer requests for reminders and calendars that arrive    */
+/*  on a Unix-domain socket.                                   */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "types.h"
+#include "protos.h"
+#include "expr.h"
+#include "globals.h"
+#include "err.h"
+
+/* Largest number of months or weeks one CALENDAR request may ask for */
+#define MAX_SERVER_CAL 120
+
+/* The calendar settings from the command line, used for CALENDAR */
+static int SrvDoCalendar;
+static int SrvDoSimpleCalendar;
+static int SrvPsCal;
+static int SrvNextMode;
+static int SrvWeeks;
+
+static int OpenServerSocket(char const *path);
+static void WarmCache(void);
+static void RefreshServer(void);
+static void ServeRequest(int fd);
+static int DoServerRequest(char const *s);
+static char const *NextWord(char const *s, char *buf, size_t len);
+
+/***************************************************************/
+/*                                                             */
+/*  RunServer                                                  */
+/*                                                             */
+/*  Handle --server: listen on a Unix-domain socket and answer */
+/*  one request per connection.  The reminder file is read     */
+/*  once up front; each request is then handled by a child     */
+/*  process, which starts with the cached and compiled lines   */
+/*  and so can begin at once.  Files that change on disk are   */
+/*  re-read before the next request.  Never returns.           */
+/*                                                             */
+/***************************************************************/
+void RunServer(void)
+{
+    int fd, c;
+    pid_t pid;
+
+    fd = OpenServerSocket(ServerSocket);
+    if (fd < 0) exit(1);
+
+    /* Remember the calendar settings for CALENDAR requests.  Without
+       a calendar option, they produce the same output as -ppp */
+    if (DoCalendar || (DoSimpleCalendar && (!NextMode || PsCal))) {
+	SrvDoCalendar = DoCalendar;
+	SrvDoSimpleCalendar = DoSimpleCalendar;
+	SrvPsCal = PsCal;
+	SrvNextMode = NextMode;
+	SrvWeeks = (CalMonths == 0);
+	DoCalendar = 0;
+	DoSimpleCalendar = 0;
+	PsCal = 0;
+	NextMode = 0;
+    } else {
+	SrvDoCalendar = 0;
+	SrvDoSimpleCalendar = 1;
+	SrvPsCal = PSCAL_LEVEL3;
+	SrvNextMode = 0;
+	SrvWeeks = 0;
+    }
+
+    ShouldCache = 1;
+    DontQueue = 1;
+    Daemon = 0;
+    IgnoreOnce = 1;
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    WarmCache();
+    while (1) {
+	c = accept(fd, NULL, NULL);
+	if (c < 0) {
+	    if (errno == EINTR || errno == ECONNABORTED) continue;
+	    fprintf(ErrFp, "%s: %s\n", ServerSocket, strerror(errno));
+	    exit(1);
+	}
+	RefreshServer();
+	fflush(stdout);
+	fflush(stderr);
+	pid = fork();
+	if (pid == 0) {
+	    close(fd);
+	    signal(SIGCHLD, SIG_DFL);
+	    signal(SIGPIPE, SIG_DFL);
+	    ServeRequest(c);
+	    fflush(stdout);
+	    _exit(0);
+	}
+	if (pid < 0) {
+	    (void) write(c, "ERROR ", 6);
+	    (void) write(c, ErrMsg[E_CANTFORK], strlen(ErrMsg[E_CANTFORK]));
+	    (void) write(c, "\n", 1);
+	}
+	close(c);
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  OpenServerSocket                                           */
+/*                                                             */
+/*  Create a Unix-domain socket listening at path.  A stale    */
+/*  socket left at path is removed first, but nothing else     */
+/*  is.  Returns the socket, or -1 on failure.                 */
+/*                                                             */
+/***************************************************************/
+static int OpenServerSocket(char const *path)
+{
+    struct sockaddr_un addr;
+    struct stat sb;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+	fprintf(ErrFp, "%s: %s\n", path, strerror(ENAMETOOLONG));
+	return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (!lstat(path, &sb) && S_ISSOCK(sb.st_mode)) {
+	unlink(path);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+	bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+	listen(fd, 64) < 0) {
+	fprintf(ErrFp, "%s: %s\n", path, strerror(errno));
+	if (fd >= 0) close(fd);
+	return -1;
+    }
+    return fd;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  WarmCache                                                  */
+/*                                                             */
+/*  Run through the reminder file once for today with output   */
+/*  and error messages thrown away, so the files it includes   */
+/*  are cached and its expressions compiled before the first   */
+/*  request.  RUN and shell() are disabled meanwhile.          */
+/*                                                             */
+/***************************************************************/
+static void WarmCache(void)
+{
+    int saved_run = RunDisabled;
+    int out, null;
+
+    fflush(stdout);
+    out = dup(STDOUT_FILENO);
+    null = open("/dev/null", O_WRONLY);
+    if (out < 0 || null < 0) {
+	if (out >= 0) close(out);
+	if (null >= 0) close(null);
+	return;
+    }
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    RunDisabled |= RUN_CMDLINE;
+    SuppressErrors = 1;
+    SetToday(RealToday);
+    RunReminderPass();
+    PerIterationInit();
+    SuppressErrors = 0;
+    RunDisabled = saved_run;
+
+    fflush(stdout);
+    dup2(out, STDOUT_FILENO);
+    close(out);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RefreshServer                                              */
+/*                                                             */
+/*  Before a request: discard cached files and directory       */
+/*  listings that changed on disk, and read the file again if  */
+/*  any did or the date has rolled over.  Cached INCLUDECMD    */
+/*  output is only thrown away when the date rolls over.       */
+/*                                                             */
+/***************************************************************/
+static void RefreshServer(void)
+{
+    int y, m, d;
+    int today = SystemDate(&y, &m, &d);
+    int rollover = (today >= 0 && today != RealToday);
+    int discarded = RefreshFileCache(rollover);
+
+    if (rollover) {
+	RealToday = today;
+	discarded = 1;
+    }
+    if (discarded) {
+	WarmCache();
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  ServeRequest                                               */
+/*                                                             */
+/*  In the child: read one request line from the connection,   */
+/*  and send the answer back on it.                            */
+/*                                                             */
+/***************************************************************/
+static void ServeRequest(int fd)
+{
+    FILE *in = fdopen(fd, "r");
+    DynamicBuffer buf;
+    int r;
+
+    if (!in) return;
+    DBufInit(&buf);
+    if (DBufGets(&buf, in) != OK) return;
+
+    fflush(stdout);
+    dup2(fd, STDOUT_FILENO);
+    r = DoServerRequest(DBufValue(&buf));
+    if (r) {
+	printf("ERROR %s\n", ErrMsg[r]);
+    }
+    DBufFree(&buf);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DoServerRequest                                            */
+/*                                                             */
+/*  Carry out a request, which is one of:                      */
+/*                                                             */
+/*    REMINDERS [date]        - as "remind file date"          */
+/*    CALENDAR [date [n]]     - a calendar for n months (or    */
+/*                              weeks) from date               */
+/*                                                             */
+/*  The date is YYYY-MM-DD and defaults to today.  Returns OK  */
+/*  or an error code.                                          */
+/*                                                             */
+/***************************************************************/
+static int DoServerRequest(char const *s)
+{
+    char cmd[16], arg[32];
+    char const *a;
+    int jul = RealToday;
+    int tim;
+    int count = 1;
+
+    s = NextWord(s, cmd, sizeof(cmd));
+    s = NextWord(s, arg, sizeof(arg));
+    if (isdigit(*arg)) {
+	a = arg;
+	if (ParseLiteralDate(&a, &jul, &tim) || tim != NO_TIME || *a) {
+	    return E_BAD_DATE;
+	}
+	s = NextWord(s, arg, sizeof(arg));
+    }
+
+    if (!strcasecmp(cmd, "REMINDERS")) {
+	if (*arg) return E_EXTRANEOUS_TOKEN;
+	SetToday(jul);
+	RunReminderPass();
+	return OK;
+    }
+
+    if (!strcasecmp(cmd, "CALENDAR")) {
+	if (*arg) {
+	    a = arg;
+	    count = 0;
+	    while (isdigit(*a) && count <= MAX_SERVER_CAL) {
+		count = count * 10 + (*a++ - '0');
+	    }
+	    if (*a && !isdigit(*a)) return E_BAD_NUMBER;
+	    if (count < 1 || count > MAX_SERVER_CAL) return E_2HIGH;
+	    s = NextWord(s, arg, sizeof(arg));
+	    if (*arg) return E_EXTRANEOUS_TOKEN;
+	}
+	SetToday(jul);
+	DoCalendar = SrvDoCalendar;
+	DoSimpleCalendar = SrvDoSimpleCalendar;
+	PsCal = SrvPsCal;
+	NextMode = SrvNextMode;
+	if (PsCal >= PSCAL_LEVEL2) {
+	    /* As with -pp, JSON includes file and line number info */
+	    DoPrefixLineNo = 1;
+	}
+	if (SrvWeeks) {
+	    CalWeeks = count;
+	    CalMonths = 0;
+	} else {
+	    CalMonths = count;
+	}
+	ProduceCalendar();
+	return OK;
+    }
+
+    return E_PARSE_ERR;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  NextWord                                                   */
+/*                                                             */
+/*  Copy the next blank-separated word of s into buf, which    */
+/*  is left empty at the end of s.  Words too long for buf     */
+/*  are truncated.  Returns the rest of s.                     */
+/*                                                             */
+/***************************************************************/
+static char const *NextWord(char const *s, char *buf, size_t len)
+{
+    size_t n = 0;
+
+    while (isspace(*s)) s++;
+    while (*s && !isspace(*s)) {
+	if (n < len - 1) buf[n++] = *s;
+	s++;
+    }
+    buf[n] = 0;
+    return s;
+}
@@ -11,6 +11,7 @@
 
 #include "config.h"
 #include <stdio.h>
+#include <string.h>
 
 #include <stdlib.h>
 #include "types.h"
@@ -24,7 +25,8 @@
 #define GOT_YR 4
 #define GOT_WD 8
 
-#define ADVANCE_TO_WD(x, wd) while (! ((wd) & (1 << ((x)%7)))) (x)++
+#define ADVANCE_TO_WD(x, wd) \
+    (x) += LowestBit(((unsigned int) ((wd) | ((wd) << 7)) >> ((x)%7)) & 0x7F)
 
 static int JYear(int jul);
 static int JMonth(int jul);
@@ -303,7 +305,7 @@ static int JYear(int jul)
 /***************************************************************/
 static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart)
 {
-    int simple, mod, omit;
+    int simple, mod, n;
 
 /* First:  Have we passed the UNTIL date? */
     if (trig->until != NO_UNTIL &&
@@ -315,20 +317,15 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 /* Next: If it's an "AFTER"-type skip, back up
    until we're at the start of a block of holidays */
     if (trig->skip == AFTER_SKIP) {
-	int iter = 0;
-	while (iter++ <= MaxSatIter) {
-	    *err = IsOmitted(start-1, trig->localomit, trig->omitfunc, &omit);
-	    if (*err) return -2;
-	    if (!omit) {
-		break;
-	    }
-	    start--;
-	}
-	if (iter > MaxSatIter) {
+	*err = OmitRun(start-1, -1, trig->localomit, trig->omitfunc,
+		       MaxSatIter, &n);
+	if (*err) return -2;
+	if (n >= MaxSatIter) {
 	    /* omitfunc must have returned "true" too often */
 	    *err = E_CANT_TRIG;
 	    return -2;
 	}
+	start -= n;
     }
 
 /* Find the next simple trigger */
@@ -347,24 +344,18 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 	    simple += mod;
 	}
 	else {
-	    int iter = 0;
 	    int max = MaxSatIter;
 	    if (max < mod*2) {
 		max = mod*2;
 	    }
-	    while(iter++ <= max) {
-		if (!mod) {
-		    break;
-		}
-		simple--;
-		*err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
-		if (*err) return -2;
-		if (!omit) mod--;
-	    }
-	    if (iter > max) {
+	    *err = NonOmittedSteps(simple-1, -1, mod, trig->localomit,
+				   trig->omitfunc, max, &n);
+	    if (*err) return -2;
+	    if (n >= max) {
 	        *err = E_CANT_TRIG;
 		return -2;
 	    }
+	    simple -= n;
 	}
     }
 
@@ -379,36 +370,26 @@ static int GetNextTriggerDate(Trigger *trig, int start, int *err, int *nextstart
 
 /* If it's a "BEFORE"-type skip, back up */
     if (trig->skip == BEFORE_SKIP) {
-	int iter = 0;
-	while(iter++ <= MaxSatIter) {
-	    *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
-	    if (*err) return -2;
-	    if (!omit) {
-		break;
-	    }
-	    simple--;
-	}
-	if (iter > MaxSatIter) {
+	*err = OmitRun(simple, -1, trig->localomit, trig->omitfunc,
+		       MaxSatIter, &n);
+	if (*err) return -2;
+	if (n >= MaxSatIter) {
 	    *err = E_CANT_TRIG;
 	    return -2;
 	}
+	simple -= n;
     }
 
 /* If it's an "AFTER"-type skip, jump ahead */
     if (trig->skip == AFTER_SKIP) {
-	int iter = 0;
-	while (iter++ <= MaxSatIter) {
-	    *err = IsOmitted(simple, trig->localomit, trig->omitfunc, &omit);
-	    if (*err) return -2;
-	    if (!omit) {
-		break;
-	    }
-	    simple++;
-	}
-	if (iter > MaxSatIter) {
+	*err = OmitRun(simple, 1, trig->localomit, trig->omitfunc,
+		       MaxSatIter, &n);
+	if (*err) return -2;
+	if (n >= MaxSatIter) {
 	    *err = E_CANT_TRIG;
 	    return -2;
 	}
+	simple += n;
     }
 
 /* Return the date */
@@ -698,3 +679,113 @@ ComputeScanStart(int today, Trigger *trig, TimeTrig *tt)
     }
     return today - days;
 }
+
+/***************************************************************/
+/*                                                             */
+/*  TriggerScanStart                                           */
+/*                                                             */
+/*  Return the date from which a parsed trigger would be       */
+/*  scanned if today's date were "today", honouring FROM and   */
+/*  SCANFROM just as ParseRem does.                            */
+/*                                                             */
+/***************************************************************/
+int TriggerScanStart(Trigger const *trig, int today)
+{
+    switch(trig->scantype) {
+    case SCAN_FIXED:
+	return trig->scanfrom;
+    case SCAN_FROM:
+	return (trig->from > today) ? trig->from : today;
+    case SCAN_BACK:
+	return today - trig->scanback;
+    default:
+	return today;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  EnumerateTriggers                                          */
+/*                                                             */
+/*  Call fn for every date from start to end, in order, on     */
+/*  which the trigger fires; that is, every date "today" for   */
+/*  which ComputeTrigger from TriggerScanStart(trig, today)    */
+/*  returns "today".  fn gets a fresh copy of the trigger and  */
+/*  time trigger as adjusted by ComputeTrigger; they are freed */
+/*  when it returns.  A non-zero return from fn stops the      */
+/*  enumeration and is returned.                               */
+/*                                                             */
+/*  For a plain trigger, the date found from a given start is  */
+/*  the first one on or after it, so every date between the    */
+/*  start and that trigger can be skipped, and the cost is     */
+/*  proportional to the number of occurrences rather than the  */
+/*  number of days.  A trigger moved back (-n or --n) or       */
+/*  around OMITs (SKIP, BEFORE, AFTER) can fire before the     */
+/*  date it was found from, and may fire again after being     */
+/*  found to have expired, so it is tried on every day.        */
+/*  The trigger must not depend on today's date other than     */
+/*  through its scan start; in particular, its OMITFUNC (if    */
+/*  any) must not consult today().                             */
+/*                                                             */
+/***************************************************************/
+int EnumerateTriggers(Trigger const *trig, TimeTrig const *tim,
+		      int start, int end, int save_in_globals,
+		      TrigFunc fn, void *data)
+{
+    Trigger t;
+    TimeTrig tt;
+    int d, r, err, scan;
+    int jump = (!trig->back && trig->skip == NO_SKIP);
+
+    /* With FROM, nothing fires before the FROM date */
+    d = start;
+    if (trig->scantype == SCAN_FROM && trig->from > d) {
+	d = trig->from;
+    }
+
+    while (d <= end) {
+	scan = TriggerScanStart(trig, d);
+	memcpy(&t, trig, sizeof(t));
+	DBufInit(&(t.tags));
+	t.scanfrom = scan;
+	tt = *tim;
+	r = ComputeTrigger(scan, &t, &tt, &err, save_in_globals);
+	if (err) return err;
+
+	/* Expired; for a plain trigger, scanning from a later date
+	   won't help */
+	if (r == -1) {
+	    if (jump) break;
+	    d++;
+	    continue;
+	}
+
+	/* A fixed SCANFROM gives the same answer whatever today is */
+	if (trig->scantype == SCAN_FIXED) {
+	    if (r < d || r > end) break;
+	    d = r;
+	}
+
+	if (r == d) {
+	    if (DBufPuts(&(t.tags), DBufValue(&(trig->tags))) != OK) {
+		return E_NO_MEM;
+	    }
+	    err = fn(d, &t, &tt, data);
+	    FreeTrig(&t);
+	    if (err) return err;
+	    if (trig->scantype == SCAN_FIXED) break;
+	    d++;
+	} else if (jump && r > d) {
+	    /* Nothing can fire before the next trigger */
+	    d = r;
+	} else if (jump && trig->scantype == SCAN_BACK &&
+		   !trig->duration_days) {
+	    /* The trigger found lies in the SCANFROM window, so it
+	       will keep being found until the window moves past it */
+	    d = r + trig->scanback + 1;
+	} else {
+	    d++;
+	}
+    }
+    return OK;
+}
@@ -41,9 +41,25 @@ typedef struct {
     char minargs;
     char maxargs;
     char is_constant;
+    char date_dep;
     int (*func)(func_info *);
 } BuiltinFunc;
 
+/* An expression compiled by CompileExpr(); private to expr.c */
+typedef struct cexpr_struct CompiledExpr;
+
+/* What the calendar remembers about a cached REM line; private to
+   calendar.c */
+typedef struct cal_memo CalMemo;
+
+/* Candidate dates a SATISFY clause is known to reject; see
+   DoSatRemind() */
+typedef struct {
+    int base;                 /* Date of the first bit */
+    int ndays;                /* Days covered by rejected */
+    unsigned char *rejected;  /* One bit per day */
+} SatMemo;
+
 /* Define the structure of a variable */
 typedef struct var {
     struct var *next;
@@ -69,6 +85,8 @@ typedef struct {
     int once;
     int scanfrom;
     int from;
+    int scantype;                /* How scanfrom depends on today */
+    int scanback;                /* Days before today for SCANFROM -n */
     int adj_for_last;            /* Adjust month/year for use of LAST */
     int need_wkday;              /* Set if we *need* a weekday */
     int priority;
@@ -93,6 +111,9 @@ typedef struct {
     int duration;
 } TimeTrig;
 
+/* Called by EnumerateTriggers for each date on which a trigger fires */
+typedef int (*TrigFunc)(int jul, Trigger *trig, TimeTrig *tim, void *data);
+
 /* The parse pointer */
 typedef struct {
     DynamicBuffer pushedToken;	/* Pushed-back token */
@@ -223,10 +244,25 @@ typedef struct {
 #define SORT_ASCEND  1
 #define SORT_DESCEND 2
 
+/* Flags for DateDependent: what per-day state an evaluation consulted */
+#define DEP_TODAY 1   /* Today's date or the current time */
+#define DEP_TRIG  2   /* The most recently computed trigger */
+#define DEP_NUMTRIG 8 /* How many reminders have been issued so far */
+
+/* For Func[].date_dep only: today's date, if the optional date
+   argument is left out */
+#define DEP_DFLTDATE 4
+
 /* Flags for FROM / SCANFROM */
 #define SCANFROM_TYPE 0
 #define FROM_TYPE     1
 
+/* How a trigger's scan start follows today's date */
+#define SCAN_TODAY    0   /* No FROM or SCANFROM: scan from today */
+#define SCAN_FIXED    1   /* SCANFROM date: always scan from that date */
+#define SCAN_FROM     2   /* FROM date: scan from the later of it and today */
+#define SCAN_BACK     3   /* SCANFROM -n: scan from n days before today */
+
 /* PS Calendar levels */
 
 /* Original interchange format */
@@ -0,0 +1,728 @@
+/***************************************************************/
+/*                                                             */
+/*  TZ.C                                                       */
+/*                                                             */
+/*  A reader for compiled (TZif) time-zone files and POSIX TZ  */
+/*  strings.  Used to convert between local time and UTC       */
+/*  without going through mktime() or changing the TZ          */
+/*  environment variable.                                      */
+/*                                                             */
+/*  This file is part of REMIND.                               */
+/*  Copyright (C) 1992-2022 by Dianne Skoll                    */
+/*                                                             */
+/***************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+
+#include <stdlib.h>
+#include "types.h"
+#include "protos.h"
+#include "expr.h"
+#include "globals.h"
+#include "err.h"
+
+/* All times in this file are in minutes since midnight, 1 January
+   BASE, which is what you get from jul * MINUTES_PER_DAY + tim.
+   Offsets are in minutes east of UTC. */
+
+/* A local-time type: offset from UTC and whether or not it's DST */
+typedef struct {
+    int off;
+    int isdst;
+} TzType;
+
+/* A POSIX-style DST rule: the date and local time of day on which
+   DST starts or ends */
+typedef struct {
+    char kind;   /* 'J' = Jn, 'D' = n, 'M' = Mm.w.d */
+    int day;
+    int mon;
+    int week;
+    int wday;
+    int secs;
+} TzRule;
+
+/* A POSIX TZ string such as "EST5EDT,M3.2.0,M11.1.0" */
+typedef struct {
+    int stdoff;
+    int dstoff;
+    int hasdst;
+    TzRule start;
+    TzRule end;
+
+    /* DST start and end (in UTC) for the year last looked at */
+    int year;
+    int ystart;
+    int yend;
+} TzPosix;
+
+typedef struct tzzone {
+    struct tzzone *next;
+    char *name;
+    int ntrans;
+    int *trans;           /* UTC time of each transition */
+    unsigned char *idx;   /* Type in effect from each transition */
+    int ntypes;
+    TzType *types;
+    int haverule;         /* Use rule after the last transition */
+    TzPosix rule;
+
+    /* The type in effect for UTC times in [lo, hi) */
+    int lo;
+    int hi;
+    TzType last;
+} TzZone;
+
+/* Named zones used by tzconvert() */
+static TzZone *Zones = NULL;
+
+/* The local time zone */
+static TzZone *LocalZone = NULL;
+
+/* Used if we can't even allocate a zone */
+static TzType UTCType = {0, 0};
+static TzZone UTCZone = {NULL, NULL, 0, NULL, NULL, 1, &UTCType, 0,
+			 {0, 0, 0, {0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0}, 0, 0, 0},
+			 INT_MIN, INT_MAX, {0, 0}};
+
+static TzZone *FindZone(char const *name);
+static TzZone *LoadZone(char const *spec);
+static int LoadTzif(TzZone *z, char const *fname);
+static int ParsePosixTz(char const *s, TzPosix *p);
+static TzType TypeAt(TzZone *z, int t);
+static TzType PosixTypeAt(TzZone *z, int t);
+static void FreeZone(TzZone *z);
+
+/***************************************************************/
+/*                                                             */
+/*  FloorDiv                                                   */
+/*                                                             */
+/*  Integer division rounding towards minus infinity.          */
+/*                                                             */
+/***************************************************************/
+static int FloorDiv(int a, int b)
+{
+    int q = a / b;
+    if ((a % b) && ((a < 0) != (b < 0))) q--;
+    return q;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TzLocalToUTC                                               */
+/*                                                             */
+/*  Convert a local time in the named zone (NULL means the     */
+/*  local zone) to UTC.  Returns the UTC time; if mins and     */
+/*  isdst are non-NULL, they are filled in with the offset     */
+/*  from UTC and DST flag in force at that time.               */
+/*                                                             */
+/*  A local time that is skipped or occurs twice when the      */
+/*  clocks change is taken to be in standard time, as mktime() */
+/*  does.                                                      */
+/*                                                             */
+/***************************************************************/
+int TzLocalToUTC(char const *zone, int local, int *mins, int *isdst)
+{
+    TzZone *z = FindZone(zone);
+    TzType before, after, type;
+    int t, okbefore, okafter;
+
+    /* Fast path: if we're well inside the last interval looked up,
+       there can be no ambiguity */
+    t = local - z->last.off;
+    if (t - 2*MINUTES_PER_DAY >= z->lo && t + 2*MINUTES_PER_DAY < z->hi) {
+	type = z->last;
+    } else {
+	before = TypeAt(z, local - MINUTES_PER_DAY);
+	after = TypeAt(z, local + MINUTES_PER_DAY);
+	if (before.off == after.off) {
+	    t = local - after.off;
+	} else {
+	    okbefore = (TypeAt(z, local - before.off).off == before.off);
+	    okafter = (TypeAt(z, local - after.off).off == after.off);
+	    if (okbefore == okafter && before.isdst != after.isdst) {
+		/* Skipped or repeated: prefer standard time */
+		okbefore = !before.isdst;
+	    } else if (okbefore == okafter) {
+		/* Skipped: as before the change.  Repeated: as after */
+		okbefore = !okbefore;
+	    }
+	    t = local - (okbefore ? before.off : after.off);
+	}
+	type = TypeAt(z, t);
+    }
+    if (mins) *mins = type.off;
+    if (isdst) *isdst = type.isdst;
+    return t;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TzUTCToLocal                                               */
+/*                                                             */
+/*  Convert a UTC time to local time in the named zone (NULL   */
+/*  means the local zone.)  mins and isdst are as for          */
+/*  TzLocalToUTC.                                              */
+/*                                                             */
+/***************************************************************/
+int TzUTCToLocal(char const *zone, int utc, int *mins, int *isdst)
+{
+    TzType type = TypeAt(FindZone(zone), utc);
+
+    if (mins) *mins = type.off;
+    if (isdst) *isdst = type.isdst;
+    return utc + type.off;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TzClearCache                                               */
+/*                                                             */
+/*  Forget all loaded zones so they are re-read when next      */
+/*  needed.                                                    */
+/*                                                             */
+/***************************************************************/
+void TzClearCache(void)
+{
+    TzZone *z;
+
+    while (Zones) {
+	z = Zones->next;
+	FreeZone(Zones);
+	Zones = z;
+    }
+    if (LocalZone) {
+	FreeZone(LocalZone);
+	LocalZone = NULL;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FindZone                                                   */
+/*                                                             */
+/*  Find a zone in the cache, loading it if necessary.  NULL   */
+/*  means the local zone, as given by $TZ.                     */
+/*                                                             */
+/***************************************************************/
+static TzZone *FindZone(char const *name)
+{
+    TzZone *z;
+
+    if (!name) {
+	if (!LocalZone) {
+	    LocalZone = LoadZone(getenv("TZ"));
+	}
+	return LocalZone;
+    }
+
+    for (z = Zones; z; z = z->next) {
+	if (!strcmp(z->name, name)) return z;
+    }
+    z = LoadZone(name);
+    if (z == &UTCZone) return z;
+    z->name = StrDup(name);
+    if (!z->name) {
+	FreeZone(z);
+	return &UTCZone;
+    }
+    z->next = Zones;
+    Zones = z;
+    return z;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  LoadZone                                                   */
+/*                                                             */
+/*  Load a zone the way the C library interprets $TZ: NULL     */
+/*  means the system default, otherwise try a zone file and    */
+/*  then a POSIX TZ string.  Anything we can't make sense of   */
+/*  is UTC.                                                    */
+/*                                                             */
+/***************************************************************/
+static TzZone *LoadZone(char const *spec)
+{
+    TzZone *z;
+    DynamicBuffer fname;
+    char const *dir;
+    int ok = 0;
+
+    z = NEW(TzZone);
+    if (!z) return &UTCZone;
+    memset(z, 0, sizeof(*z));
+
+    if (!spec) {
+	ok = LoadTzif(z, LOCALTIME_FILE);
+    } else if (*spec) {
+	if (*spec == ':') spec++;
+	if (*spec == '/') {
+	    ok = LoadTzif(z, spec);
+	} else if (*spec) {
+	    dir = getenv("TZDIR");
+	    if (!dir || !*dir) dir = ZONEINFO_DIR;
+	    DBufInit(&fname);
+	    if (DBufPuts(&fname, dir) == OK &&
+		DBufPutc(&fname, '/') == OK &&
+		DBufPuts(&fname, spec) == OK) {
+		ok = LoadTzif(z, DBufValue(&fname));
+	    }
+	    DBufFree(&fname);
+	}
+	if (!ok && ParsePosixTz(spec, &z->rule)) {
+	    z->haverule = 1;
+	    z->types = NEW(TzType);
+	    if (z->types) {
+		z->ntypes = 1;
+		z->types[0].off = z->rule.stdoff;
+		z->types[0].isdst = 0;
+		ok = 1;
+	    }
+	}
+    }
+
+    if (!ok) {
+	FreeZone(z);
+	z = NEW(TzZone);
+	if (!z) return &UTCZone;
+	*z = UTCZone;
+	z->types = NEW(TzType);
+	if (!z->types) {
+	    free(z);
+	    return &UTCZone;
+	}
+	z->types[0] = UTCType;
+    }
+    z->next = NULL;
+    z->name = NULL;
+    z->lo = 0;
+    z->hi = 0;
+    z->last = z->types[0];
+    z->rule.year = INT_MIN;
+    return z;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  FreeZone                                                   */
+/*                                                             */
+/***************************************************************/
+static void FreeZone(TzZone *z)
+{
+    if (z == &UTCZone) return;
+    if (z->name) free(z->name);
+    if (z->trans) free(z->trans);
+    if (z->idx) free(z->idx);
+    if (z->types) free(z->types);
+    free(z);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TypeAt                                                     */
+/*                                                             */
+/*  Find the local-time type in force at UTC time t.           */
+/*                                                             */
+/***************************************************************/
+static TzType TypeAt(TzZone *z, int t)
+{
+    int lo, hi, mid;
+
+    if (t >= z->lo && t < z->hi) return z->last;
+
+    if (z->haverule && (!z->ntrans || t >= z->trans[z->ntrans-1])) {
+	return PosixTypeAt(z, t);
+    }
+
+    if (!z->ntrans || t < z->trans[0]) {
+	z->lo = INT_MIN;
+	z->hi = z->ntrans ? z->trans[0] : INT_MAX;
+	z->last = z->types[0];
+	return z->last;
+    }
+
+    /* Find the last transition at or before t */
+    lo = 0;
+    hi = z->ntrans - 1;
+    while (lo < hi) {
+	mid = lo + (hi - lo + 1) / 2;
+	if (z->trans[mid] <= t) lo = mid;
+	else hi = mid - 1;
+    }
+    z->lo = z->trans[lo];
+    z->hi = (lo + 1 < z->ntrans) ? z->trans[lo+1] : INT_MAX;
+    z->last = z->types[z->idx[lo]];
+    return z->last;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RuleDay                                                    */
+/*                                                             */
+/*  Return the Julian date on which a DST rule fires in a      */
+/*  given year.                                                */
+/*                                                             */
+/***************************************************************/
+static int RuleDay(TzRule const *r, int y)
+{
+    int jul, end;
+
+    switch(r->kind) {
+    case 'J':
+	jul = Julian(y, 0, 1) + r->day - 1;
+	if (r->day >= 60 && IsLeapYear(y)) jul++;
+	return jul;
+
+    case 'D':
+	return Julian(y, 0, 1) + r->day;
+
+    default:
+	jul = Julian(y, r->mon - 1, 1);
+	end = jul + DaysInMonth(r->mon - 1, y);
+
+	/* Julian day 0 is a Monday; POSIX weekday 0 is a Sunday */
+	jul += (r->wday - (jul + 1) % 7 + 7) % 7 + 7 * (r->week - 1);
+	while (jul >= end) jul -= 7;
+	return jul;
+    }
+}
+
+/***************************************************************/
+/*                                                             */
+/*  PosixTypeAt                                                */
+/*                                                             */
+/*  Find the local-time type in force at UTC time t using the  */
+/*  zone's POSIX rule.                                         */
+/*                                                             */
+/***************************************************************/
+static TzType PosixTypeAt(TzZone *z, int t)
+{
+    TzPosix *p = &z->rule;
+    TzType type;
+    int y, m, d, dst;
+    int ystart, yend, b1, b2, lo, hi;
+
+    type.off = p->stdoff;
+    type.isdst = 0;
+
+    if (!p->hasdst) {
+	lo = z->ntrans ? z->trans[z->ntrans-1] : INT_MIN;
+	hi = INT_MAX;
+    } else {
+	FromJulian(FloorDiv(t + p->stdoff, MINUTES_PER_DAY), &y, &m, &d);
+	if (y != p->year) {
+	    p->ystart = RuleDay(&p->start, y) * MINUTES_PER_DAY +
+		FloorDiv(p->start.secs, 60) - p->stdoff;
+	    p->yend = RuleDay(&p->end, y) * MINUTES_PER_DAY +
+		FloorDiv(p->end.secs, 60) - p->dstoff;
+	    p->year = y;
+	}
+	ystart = p->ystart;
+	yend = p->yend;
+	if (ystart < yend) {
+	    dst = (t >= ystart && t < yend);
+	} else {
+	    dst = (t < yend || t >= ystart);
+	}
+	if (dst) {
+	    type.off = p->dstoff;
+	    type.isdst = 1;
+	}
+
+	/* Work out how far this answer holds for the cache */
+	b1 = (ystart < yend) ? ystart : yend;
+	b2 = (ystart < yend) ? yend : ystart;
+	if (t < b1) {
+	    lo = Julian(y, 0, 1) * MINUTES_PER_DAY - p->stdoff;
+	    hi = b1;
+	} else if (t < b2) {
+	    lo = b1;
+	    hi = b2;
+	} else {
+	    lo = b2;
+	    hi = Julian(y+1, 0, 1) * MINUTES_PER_DAY - p->stdoff;
+	}
+	if (z->ntrans && lo < z->trans[z->ntrans-1]) {
+	    lo = z->trans[z->ntrans-1];
+	}
+    }
+    if (t >= lo && t < hi) {
+	z->lo = lo;
+	z->hi = hi;
+	z->last = type;
+    }
+    return type;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  POSIX TZ string parsing                                    */
+/*                                                             */
+/*  std offset [dst [offset] [,start[/time],end[/time]]]       */
+/*                                                             */
+/***************************************************************/
+static char const *ParseTzName(char const *s)
+{
+    char const *t;
+
+    if (*s == '<') {
+	s = strchr(s, '>');
+	return s ? s+1 : NULL;
+    }
+    t = s;
+    while (isalpha((unsigned char) *s)) s++;
+    return (s - t >= 3) ? s : NULL;
+}
+
+static char const *ParseTzNum(char const *s, int *val, int lo, int hi)
+{
+    int n = 0;
+
+    if (!isdigit((unsigned char) *s)) return NULL;
+    while (isdigit((unsigned char) *s)) {
+	n = n * 10 + (*s++ - '0');
+	if (n > hi) return NULL;
+    }
+    if (n < lo) return NULL;
+    *val = n;
+    return s;
+}
+
+/* [+-]hh[:mm[:ss]], returned in seconds */
+static char const *ParseTzSecs(char const *s, int *secs)
+{
+    int sign = 1, h, m = 0, sec = 0;
+
+    if (*s == '+') {
+	s++;
+    } else if (*s == '-') {
+	sign = -1;
+	s++;
+    }
+    s = ParseTzNum(s, &h, 0, 167);
+    if (s && *s == ':') {
+	s = ParseTzNum(s+1, &m, 0, 59);
+	if (s && *s == ':') {
+	    s = ParseTzNum(s+1, &sec, 0, 59);
+	}
+    }
+    if (!s) return NULL;
+    *secs = sign * (h * 3600 + m * 60 + sec);
+    return s;
+}
+
+static char const *ParseTzRule(char const *s, TzRule *r)
+{
+    r->secs = 2 * 3600;
+    if (*s == 'J') {
+	r->kind = 'J';
+	s = ParseTzNum(s+1, &r->day, 1, 365);
+    } else if (*s == 'M') {
+	r->kind = 'M';
+	s = ParseTzNum(s+1, &r->mon, 1, 12);
+	if (!s || *s != '.') return NULL;
+	s = ParseTzNum(s+1, &r->week, 1, 5);
+	if (!s || *s != '.') return NULL;
+	s = ParseTzNum(s+1, &r->wday, 0, 6);
+    } else {
+	r->kind = 'D';
+	s = ParseTzNum(s, &r->day, 0, 365);
+    }
+    if (s && *s == '/') {
+	s = ParseTzSecs(s+1, &r->secs);
+    }
+    return s;
+}
+
+static int ParsePosixTz(char const *s, TzPosix *p)
+{
+    int secs;
+
+    s = ParseTzName(s);
+    if (!s) return 0;
+    s = ParseTzSecs(s, &secs);
+    if (!s) return 0;
+
+    /* POSIX offsets are positive west of Greenwich */
+    p->stdoff = -secs / 60;
+    p->dstoff = p->stdoff;
+    p->hasdst = 0;
+    p->year = INT_MIN;
+    if (!*s) return 1;
+
+    s = ParseTzName(s);
+    if (!s) return 0;
+    p->hasdst = 1;
+    p->dstoff = p->stdoff + 60;
+    if (*s && *s != ',') {
+	s = ParseTzSecs(s, &secs);
+	if (!s) return 0;
+	p->dstoff = -secs / 60;
+    }
+
+    if (!*s) {
+	/* No rules given: use the current US rules, as the C
+	   library does */
+	p->start.kind = p->end.kind = 'M';
+	p->start.mon = 3;
+	p->start.week = 2;
+	p->end.mon = 11;
+	p->end.week = 1;
+	p->start.wday = p->end.wday = 0;
+	p->start.secs = p->end.secs = 2 * 3600;
+	return 1;
+    }
+
+    if (*s != ',') return 0;
+    s = ParseTzRule(s+1, &p->start);
+    if (!s || *s != ',') return 0;
+    s = ParseTzRule(s+1, &p->end);
+    return (s && !*s);
+}
+
+/***************************************************************/
+/*                                                             */
+/*  TZif file parsing                                          */
+/*                                                             */
+/***************************************************************/
+static long Get32(unsigned char const *p)
+{
+    unsigned long v = ((unsigned long) p[0] << 24) |
+	((unsigned long) p[1] << 16) |
+	((unsigned long) p[2] << 8) |
+	(unsigned long) p[3];
+    if (v & 0x80000000UL) return -(long) (0xFFFFFFFFUL - v) - 1;
+    return (long) v;
+}
+
+/* Convert seconds since the Unix epoch to our minutes, clamping
+   times that are out of range */
+static int EpochToMinutes(double secs)
+{
+    double m = floor(secs / 60.0) +
+	(double) Julian(1970, 0, 1) * MINUTES_PER_DAY;
+
+    if (m < -INT_MAX) return -INT_MAX;
+    if (m >= INT_MAX) return INT_MAX - 1;
+    return (int) m;
+}
+
+static int LoadTzif(TzZone *z, char const *fname)
+{
+    FILE *fp;
+    unsigned char *buf, *p, *end;
+    long len;
+    long counts[6];
+    long isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt;
+    int timesize, i, ok = 0;
+    unsigned char *q;
+
+    fp = fopen(fname, "rb");
+    if (!fp) return 0;
+    if (fseek(fp, 0L, SEEK_END) || (len = ftell(fp)) < 44 ||
+	fseek(fp, 0L, SEEK_SET)) {
+	fclose(fp);
+	return 0;
+    }
+    buf = malloc(len);
+    if (!buf) {
+	fclose(fp);
+	return 0;
+    }
+    if (fread(buf, 1, len, fp) != (size_t) len) {
+	fclose(fp);
+	free(buf);
+	return 0;
+    }
+    fclose(fp);
+
+    p = buf;
+    end = buf + len;
+    timesize = 4;
+    while(1) {
+	if (end - p < 44 || memcmp(p, "TZif", 4)) goto done;
+	for (i=0; i<6; i++) {
+	    counts[i] = Get32(p + 20 + 4*i);
+	    if (counts[i] < 0 || counts[i] > len) goto done;
+	}
+	isutcnt = counts[0];
+	isstdcnt = counts[1];
+	leapcnt = counts[2];
+	timecnt = counts[3];
+	typecnt = counts[4];
+	charcnt = counts[5];
+	if (typecnt < 1 || typecnt > 256) goto done;
+	if (end - p - 44 < timecnt * (timesize + 1) + typecnt * 6 + charcnt +
+	    leapcnt * (timesize + 4) + isstdcnt + isutcnt) goto done;
+
+	/* Version 2 and later files repeat the data with 64-bit
+	   times; skip the 32-bit data */
+	if (timesize == 4 && p[4] >= '2') {
+	    p += 44 + timecnt * 5 + typecnt * 6 + charcnt + leapcnt * 8 +
+		isstdcnt + isutcnt;
+	    timesize = 8;
+	    continue;
+	}
+	break;
+    }
+
+    p += 44;
+    z->ntrans = (int) timecnt;
+    z->ntypes = (int) typecnt;
+    z->trans = malloc(sizeof(int) * (timecnt ? timecnt : 1));
+    z->idx = malloc(timecnt ? timecnt : 1);
+    z->types = malloc(sizeof(TzType) * typecnt);
+    if (!z->trans || !z->idx || !z->types) goto done;
+
+    for (i=0; i<timecnt; i++) {
+	q = p + i * timesize;
+	if (timesize == 8) {
+	    z->trans[i] = EpochToMinutes((double) Get32(q) * 4294967296.0 +
+					 (double) ((unsigned long) Get32(q+4) & 0xFFFFFFFFUL));
+	} else {
+	    z->trans[i] = EpochToMinutes((double) Get32(q));
+	}
+    }
+    p += timecnt * timesize;
+    for (i=0; i<timecnt; i++) {
+	if (p[i] >= typecnt) goto done;
+	z->idx[i] = p[i];
+    }
+    p += timecnt;
+    for (i=0; i<typecnt; i++) {
+	z->types[i].off = (int) (Get32(p) / 60);
+	z->types[i].isdst = p[4] ? 1 : 0;
+	p += 6;
+    }
+    p += charcnt + leapcnt * (timesize + 4) + isstdcnt + isutcnt;
+
+    /* The footer holds a POSIX TZ string for times after the last
+       transition */
+    if (timesize == 8 && p < end && *p == '\n') {
+	q = memchr(p+1, '\n', end - p - 1);
+	if (q && q > p+1) {
+	    *q = 0;
+	    z->haverule = ParsePosixTz((char const *) p+1, &z->rule);
+	}
+    }
+    ok = 1;
+
+  done:
+    free(buf);
+    if (!ok) {
+	if (z->trans) free(z->trans);
+	if (z->idx) free(z->idx);
+	if (z->types) free(z->types);
+	z->trans = NULL;
+	z->idx = NULL;
+	z->types = NULL;
+	z->ntrans = z->ntypes = 0;
+    }
+    return ok;
+}
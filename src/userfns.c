@@ -29,6 +29,7 @@ typedef struct udf_struct {
     struct udf_struct *next;
     char name[VAR_NAME_LEN+1];
     char const *text;
+    CompiledExpr *code;
     Var *locals;
     char IsActive;
     int nargs;
@@ -52,6 +53,7 @@ static void FUnset (char const *name);
 static void FSet (UserFunc *f);
 static int SetUpLocalVars (UserFunc *f);
 static void DestroyLocalVals (UserFunc *f);
+static char const *FuncBody (UserFunc *f);
 
 /***************************************************************/
 /*                                                             */
@@ -65,8 +67,8 @@ int DoFset(ParsePtr p)
     int r;
     int c;
     UserFunc *func;
-    Var *v;
-    int orig_namelen;
+    Var *v, tmp;
+    int orig_namelen, i;
 
     DynamicBuffer buf;
     DBufInit(&buf);
@@ -109,12 +111,15 @@ int DoFset(ParsePtr p)
     }
     func->locals = NULL;
     func->text = NULL;
+    func->code = NULL;
     func->IsActive = 0;
     func->nargs = 0;
 
-    /* Get the local variables - we insert the local variables in REVERSE
+    /* Get the local variables - we keep the local variables in REVERSE
        order, but that's OK, because we pop them off the stack in reverse
-       order, too, so everything works out just fine. */
+       order, too, so everything works out just fine.  They live in one
+       array, linked in that order, so that compiled code can find each
+       one by its position. */
 
     c=ParseNonSpaceChar(p, &r, 1);
     if (r) return r;
@@ -129,18 +134,19 @@ int DoFset(ParsePtr p)
 		DestroyUserFunc(func);
 		return E_BAD_ID;
 	    }
-	    v = NEW(Var);
+	    v = realloc(func->locals, (func->nargs+1) * sizeof(Var));
 	    if (!v) {
 		DBufFree(&buf);
 		DestroyUserFunc(func);
 		return E_NO_MEM;
 	    }
-	    func->nargs++;
+	    func->locals = v;
+	    v = &func->locals[func->nargs++];
+	    v->next = NULL;
+	    v->preserve = 0;
 	    v->v.type = ERR_TYPE;
 	    StrnCpy(v->name, DBufValue(&buf), VAR_NAME_LEN);
 	    DBufFree(&buf);
-	    v->next = func->locals;
-	    func->locals = v;
 	    c = ParseNonSpaceChar(p, &r, 0);
 	    if (c == ')') break;
 	    else if (c != ',') {
@@ -148,6 +154,14 @@ int DoFset(ParsePtr p)
 		return E_PARSE_ERR;
 	    }
 	}
+	for (i=0; i<func->nargs/2; i++) {
+	    tmp = func->locals[i];
+	    func->locals[i] = func->locals[func->nargs-1-i];
+	    func->locals[func->nargs-1-i] = tmp;
+	}
+	for (i=0; i<func->nargs-1; i++) {
+	    func->locals[i].next = &func->locals[i+1];
+	}
     }
 
     /* Allow an optional = sign: FSET f(x) = x*x */
@@ -168,6 +182,10 @@ int DoFset(ParsePtr p)
 	return E_NO_MEM;
     }
 
+    /* Compile the body now so calls needn't parse it again; if it
+       can't be compiled, it is simply evaluated from the text */
+    func->code = CompileExpr(FuncBody(func), func->locals);
+
     /* If an old definition of this function exists, destroy it */
     FUnset(func->name);
 
@@ -189,19 +207,17 @@ int DoFset(ParsePtr p)
 /***************************************************************/
 static void DestroyUserFunc(UserFunc *f)
 {
-    Var *v, *prev;
+    int i;
 
     /* Free the local variables first */
-    v = f->locals;
-    while(v) {
-	DestroyValue(v->v);
-	prev = v;
-	v = v->next;
-	free(prev);
+    for (i=0; i<f->nargs; i++) {
+	DestroyValue(f->locals[i].v);
     }
+    if (f->locals) free(f->locals);
 
     /* Free the function definition */
     if (f->text) free( (char *) f->text);
+    FreeCompiledExpr(f->code);
 
     /* Free the filename */
     if (f->filename) free( (char *) f->filename);
@@ -235,6 +251,7 @@ static void FUnset(char const *name)
     if (!cur) return;
     if (prev) prev->next = cur->next; else FuncHash[h] = cur->next;
     DestroyUserFunc(cur);
+    ClearOmitFuncCache();
 }
 
 /***************************************************************/
@@ -249,6 +266,31 @@ static void FSet(UserFunc *f)
     int h = HashVal(f->name) % FUNC_HASH_SIZE;
     f->next = FuncHash[h];
     FuncHash[h] = f;
+    ClearOmitFuncCache();
+}
+
+/***************************************************************/
+/*                                                             */
+/*  DestroyUserFuncs                                           */
+/*                                                             */
+/*  Delete all user-defined functions.                         */
+/*                                                             */
+/***************************************************************/
+void DestroyUserFuncs(void)
+{
+    UserFunc *f, *next;
+    int h;
+
+    for (h=0; h<FUNC_HASH_SIZE; h++) {
+	f = FuncHash[h];
+	FuncHash[h] = NULL;
+	while(f) {
+	    next = f->next;
+	    DestroyUserFunc(f);
+	    f = next;
+	}
+    }
+    ClearOmitFuncCache();
 }
 
 /***************************************************************/
@@ -311,13 +353,16 @@ int CallUserFunc(char const *name, int nargs, ParsePtr p)
 
     /* Evaluate the expression */
     f->IsActive = 1;
-    s = f->text;
+    s = FuncBody(f);
 
-    /* Skip the opening bracket, if there's one */
-    while (isempty(*s)) s++;
-    if (*s == BEG_OF_EXPR) s++;
+    /* A change of date or time separator changes how the body is
+       tokenized, so compile it again */
+    if (f->code && CompiledExprStale(f->code)) {
+	FreeCompiledExpr(f->code);
+	f->code = CompileExpr(s, f->locals);
+    }
     push_call(f->filename, f->name, f->lineno);
-    h = Evaluate(&s, f->locals, p);
+    h = EvaluateCompiled(f->code, &s, f->locals, p);
     if (h == OK) {
         pop_call();
     }
@@ -391,3 +436,20 @@ int UserFuncExists(char const *fn)
     else return f->nargs;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  FuncBody                                                   */
+/*                                                             */
+/*  Return the start of the expression making up the body of   */
+/*  a user-defined function, skipping the opening bracket if   */
+/*  there is one.                                              */
+/*                                                             */
+/***************************************************************/
+static char const *FuncBody(UserFunc *f)
+{
+    char const *s = f->text;
+
+    while (isempty(*s)) s++;
+    if (*s == BEG_OF_EXPR) s++;
+    return s;
+}
@@ -20,6 +20,7 @@ static char const DontEscapeMe[] =
 #include <ctype.h>
 
 #include <stdlib.h>
+#include <limits.h>
 #include "types.h"
 #include "globals.h"
 #include "protos.h"
@@ -128,6 +129,58 @@ int DateOK(int y, int m, int d)
     else return 1;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  LowestBit, HighestBit and CountBits                        */
+/*                                                             */
+/*  The position of the lowest and highest bits set in x,      */
+/*  which must not be 0, and the number of bits set in x.      */
+/*  These use the compiler's single-instruction versions if    */
+/*  it has them.                                               */
+/*                                                             */
+/***************************************************************/
+int LowestBit(unsigned int x)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(x);
+#else
+    int n = 0;
+    while (!(x & 1)) {
+	x >>= 1;
+	n++;
+    }
+    return n;
+#endif
+}
+
+int HighestBit(unsigned int x)
+{
+#ifdef __GNUC__
+    return (int) (sizeof(unsigned int) * CHAR_BIT) - 1 - __builtin_clz(x);
+#else
+    int n = -1;
+    while (x) {
+	x >>= 1;
+	n++;
+    }
+    return n;
+#endif
+}
+
+int CountBits(unsigned int x)
+{
+#ifdef __GNUC__
+    return __builtin_popcount(x);
+#else
+    int n = 0;
+    while (x) {
+	x &= x - 1;
+	n++;
+    }
+    return n;
+#endif
+}
+
 /* Functions designed to defeat gcc optimizer */
 
 int _private_mul_overflow(int a, int b)
@@ -170,6 +170,7 @@ static int latitude_func(int do_set, Value *val)
 static int trig_date_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DateDependent |= DEP_TRIG;
     if (!LastTrigValid) {
         val->type = INT_TYPE;
 	val->v.val = 0;
@@ -183,6 +184,7 @@ static int trig_day_func(int do_set, Value *val)
 {
     int y, m, d;
     UNUSED(do_set);
+    DateDependent |= DEP_TRIG;
     val->type = INT_TYPE;
     if (!LastTrigValid) {
 	val->v.val = -1;
@@ -198,6 +200,7 @@ static int trig_mon_func(int do_set, Value *val)
 {
     int y, m, d;
     UNUSED(do_set);
+    DateDependent |= DEP_TRIG;
     val->type = INT_TYPE;
     if (!LastTrigValid) {
 	val->v.val = -1;
@@ -213,6 +216,7 @@ static int trig_year_func(int do_set, Value *val)
 {
     int y, m, d;
     UNUSED(do_set);
+    DateDependent |= DEP_TRIG;
     val->type = INT_TYPE;
     if (!LastTrigValid) {
 	val->v.val = -1;
@@ -228,6 +232,7 @@ static int trig_wday_func(int do_set, Value *val)
 {
     val->type = INT_TYPE;
     UNUSED(do_set);
+    DateDependent |= DEP_TRIG;
     if (!LastTrigValid) {
 	val->v.val = -1;
 	return OK;
@@ -240,6 +245,7 @@ static int trig_wday_func(int do_set, Value *val)
 static int today_date_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DateDependent |= DEP_TODAY;
     val->type = DATE_TYPE;
     val->v.val = JulianToday;
     return OK;
@@ -248,6 +254,7 @@ static int today_day_func(int do_set, Value *val)
 {
     int y, m, d;
     UNUSED(do_set);
+    DateDependent |= DEP_TODAY;
     val->type = INT_TYPE;
     FromJulian(JulianToday, &y, &m, &d);
     val->v.val = d;
@@ -258,6 +265,7 @@ static int today_mon_func(int do_set, Value *val)
 {
     int y, m, d;
     UNUSED(do_set);
+    DateDependent |= DEP_TODAY;
     val->type = INT_TYPE;
     FromJulian(JulianToday, &y, &m, &d);
     val->v.val = m+1;
@@ -268,6 +276,7 @@ static int today_year_func(int do_set, Value *val)
 {
     int y, m, d;
     UNUSED(do_set);
+    DateDependent |= DEP_TODAY;
     val->type = INT_TYPE;
     FromJulian(JulianToday, &y, &m, &d);
     val->v.val = y;
@@ -277,6 +286,7 @@ static int today_year_func(int do_set, Value *val)
 static int today_wday_func(int do_set, Value *val)
 {
     UNUSED(do_set);
+    DateDependent |= DEP_TODAY;
     val->type = INT_TYPE;
     val->v.val = (JulianToday + 1) % 7;
     return OK;
@@ -462,6 +472,7 @@ int DeleteVar(char const *str)
     DestroyValue(v->v);
     if (prev) prev->next = v->next; else VHashTbl[h] = v->next;
     free(v);
+    ClearOmitFuncCache();
     return OK;
 }
 
@@ -480,6 +491,7 @@ int SetVar(char const *str, Value *val)
 
     DestroyValue(v->v);
     v->v = *val;
+    ClearOmitFuncCache();
     return OK;
 }
 
@@ -672,6 +684,7 @@ void DestroyVars(int all)
     int i;
     Var *v, *next, *prev;
 
+    ClearOmitFuncCache();
     for (i=0; i<VAR_HASH_SIZE; i++) {
 	v = VHashTbl[i];
 	VHashTbl[i] = NULL;
@@ -844,6 +857,8 @@ static SysVar SysVarArr[] = {
     {"RunOff",         0,  INT_TYPE,     &RunDisabled,         0,      0,    NULL },
     {"Saturday",       1,  STR_TYPE,     &DynamicDayName[5],   0,      0,    NULL },
     {"September",      1,  STR_TYPE,     &DynamicMonthName[8], 0,      0,    NULL },
+    {"ShellCache",     1,  INT_TYPE,     &CacheShellOutput,    0,      1,    NULL },
+    {"ShellCacheTTL",  1,  INT_TYPE,     &ShellCacheTTL,       0,      ANY,  NULL },
     {"SimpleCal",      0,  INT_TYPE,     &DoSimpleCalendar,    0,      0,    NULL },
     {"SortByDate",     0,  INT_TYPE,     &SortByDate,          0,      0,    NULL },
     {"SortByPrio",     0,  INT_TYPE,     &SortByPrio,          0,      0,    NULL },
@@ -873,6 +888,17 @@ static SysVar SysVarArr[] = {
 };
 
 #define NUMSYSVARS ( sizeof(SysVarArr) / sizeof(SysVar) )
+
+/* The modifiable system variables as the command line left them */
+typedef struct {
+    int val;            /* For INT_TYPE */
+    char *str;          /* For STR_TYPE; never freed */
+} SavedSysVar;
+
+static SavedSysVar SavedSysVars[NUMSYSVARS];
+static char SavedDateSep, SavedTimeSep, SavedDateTimeSep;
+static double SavedLatitude, SavedLongitude;
+
 static SysVar *FindSysVar (char const *name);
 static void DumpSysVar (char const *name, const SysVar *v);
 /***************************************************************/
@@ -893,6 +919,7 @@ int SetSysVar(char const *name, Value *value)
 	Eprint("%s: `$%s'", ErrMsg[E_CANT_MODIFY], name);
 	return E_CANT_MODIFY;
     }
+    ClearOmitFuncCache();
 
     if (v->type == SPECIAL_TYPE) {
 	SysVarFunc f = (SysVarFunc) v->value;
@@ -958,6 +985,12 @@ int GetSysVar(char const *name, Value *val)
     }
     val->type = v->type;
 
+    /* $NumTrig and $NumQueued change as reminders are issued */
+    if (v->value == (void *) &NumTriggered ||
+	v->value == (void *) &NumQueued) {
+	DateDependent |= DEP_TODAY | DEP_NUMTRIG;
+    }
+
     /* In "verbose" mode, print attempts to test $RunOff */
     if (DebugFlag & DB_PRTLINE) {
 	if (v->value == (void *) &RunDisabled) {
@@ -990,6 +1023,79 @@ static SysVar *FindSysVar(char const *name)
     return NULL;
 }
 
+/***************************************************************/
+/*                                                             */
+/*  SaveSysVars                                                */
+/*                                                             */
+/*  Remember the values of the modifiable system variables, so */
+/*  that RestoreSysVars() can undo whatever a reminder file    */
+/*  sets them to.  Called once, after the command line has     */
+/*  been processed.                                            */
+/*                                                             */
+/***************************************************************/
+void SaveSysVars(void)
+{
+    size_t i;
+    SysVar *v;
+    char *s;
+
+    for (i=0; i<NUMSYSVARS; i++) {
+	v = &SysVarArr[i];
+	if (!v->modifiable) continue;
+	if (v->type == INT_TYPE) {
+	    SavedSysVars[i].val = *((int *) v->value);
+	} else if (v->type == STR_TYPE) {
+	    s = *((char **) v->value);
+	    if (v->been_malloced && s) {
+		s = StrDup(s);
+		if (!s) continue;
+	    }
+	    SavedSysVars[i].str = s;
+	}
+    }
+
+    /* The values behind the SPECIAL_TYPE variables */
+    SavedDateSep = DateSep;
+    SavedTimeSep = TimeSep;
+    SavedDateTimeSep = DateTimeSep;
+    SavedLatitude = Latitude;
+    SavedLongitude = Longitude;
+}
+
+/***************************************************************/
+/*                                                             */
+/*  RestoreSysVars                                             */
+/*                                                             */
+/*  Put back the values remembered by SaveSysVars().  String   */
+/*  variables point at the saved copies, which are never       */
+/*  freed.                                                     */
+/*                                                             */
+/***************************************************************/
+void RestoreSysVars(void)
+{
+    size_t i;
+    SysVar *v;
+
+    for (i=0; i<NUMSYSVARS; i++) {
+	v = &SysVarArr[i];
+	if (!v->modifiable) continue;
+	if (v->type == INT_TYPE) {
+	    *((int *) v->value) = SavedSysVars[i].val;
+	} else if (v->type == STR_TYPE) {
+	    if (v->been_malloced) free(*((char **) v->value));
+	    *((char **) v->value) = SavedSysVars[i].str;
+	    v->been_malloced = 0;
+	}
+    }
+
+    DateSep = SavedDateSep;
+    TimeSep = SavedTimeSep;
+    DateTimeSep = SavedDateTimeSep;
+    Latitude = SavedLatitude;
+    Longitude = SavedLongitude;
+    set_components_from_lat_and_long();
+}
+
 /***************************************************************/
 /*                                                             */
 /*  DumpSysVarByName                                           */
@@ -0,0 +1 @@
+#define VERSION "04.00.01"